@@ -7,40 +7,48 @@
 
 #include "BlockParser.h"
 
-#include <QString>
-
 #include <boost/algorithm/string.hpp>
 #include <boost/algorithm/string/regex.hpp>
 #include <boost/regex.hpp>
 
 #include "MarkdownCpp.h"
+#include "Context.h"
 
 namespace markdown{
 
 BlockParser::BlockParser(Markdown *markdown) :
 	markdown(markdown),
-    blockprocessors(), root(ElementTree::InvalidElementTree)
+    blockprocessors(),
+    BLOCK_SEPARATOR_RE(RegexCache::get(L"\n\n"))
 {}
 
 ElementTree BlockParser::parseDocument(const std::list<std::wstring> &lines)
 {
-    this->root = ElementTree(this->markdown->doc_tag());
-    Element tmp(this->root);
-    this->parseChunk(tmp, boost::algorithm::join(lines, L"\n"));
-	return this->root;
+    return this->parseDocument(boost::algorithm::join(lines, L"\n"));
+}
+
+ElementTree BlockParser::parseDocument(const std::wstring &text)
+{
+    ElementTree root = Context::current().newDocument(this->markdown->doc_tag());
+    Element tmp(root);
+    this->parseChunk(tmp, text);
+	return root;
 }
 
 void BlockParser::parseChunk(Element &parent, const std::wstring &text)
 {
     std::list<std::wstring> buffer;
-	boost::split_regex(buffer, text, boost::wregex(L"\n\n"));
+	boost::split_regex(buffer, text, this->BLOCK_SEPARATOR_RE);
 	this->parseBlocks(parent, buffer);
 }
 
 void BlockParser::parseBlocks(Element &parent, std::list<std::wstring> &blocks)
 {
+    BudgetMeter& meter = Context::current().meter;
+    BudgetMeter::Nesting nesting(meter);
 	while ( blocks.size() > 0 ) {
         for (OrderedDictBlockProcessors::Ptr processor : this->blockprocessors.toList()) {
+            meter.step();
 			if ( processor->test(parent, blocks.front()) ) {
 				processor->run(parent, blocks);
 				break;
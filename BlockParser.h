@@ -8,6 +8,8 @@
 #ifndef BLOCKPARSER_H_
 #define BLOCKPARSER_H_
 
+#include <boost/regex.hpp>
+
 #include "BlockProcessors.h"
 
 namespace markdown{
@@ -81,11 +83,16 @@ public:
 	 *
 	 *   Given a list of lines, an ElementTree object (not just a parent Element)
 	 *   is created and the root element is passed to the parser as the parent.
-	 *   The ElementTree object is returned.
+	 *   The ElementTree object is returned. The nesting state is kept in the
+	 *   current Context, so the parser itself is not modified.
 	 *
 	 *   This should only be called on an entire document, not pieces.
 	 */
     ElementTree parseDocument(const std::list<std::wstring> &lines);
+    /*!
+     * Parse a markdown document given as a single string.
+     */
+    ElementTree parseDocument(const std::wstring &text);
 
 	/*!
 	 * Parse a chunk of markdown text and attach to given etree node.
@@ -116,8 +123,9 @@ public:
 public:
 	Markdown* markdown;
 	OrderedDictBlockProcessors blockprocessors;
-    State state;
-    ElementTree root;
+
+private:
+    const boost::wregex BLOCK_SEPARATOR_RE;  //!< blocks are separated by blank lines
 
 };
 
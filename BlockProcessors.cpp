@@ -7,12 +7,15 @@
 
 #include "BlockProcessors.h"
 
+#include <iostream>
+
 #include <boost/algorithm/string.hpp>
 #include <boost/format.hpp>
 #include <boost/regex.hpp>
 
 #include "MarkdownCpp.h"
 #include "BlockParser.h"
+#include "Context.h"
 
 namespace markdown{
 
@@ -25,7 +28,7 @@ BlockProcessor::~BlockProcessor()
 
 Element BlockProcessor::lastChild(const Element &parent)
 {
-    if ( parent.child().size() > 0 ) {
+    if ( parent.hasChildren() ) {
         return parent.getLastElementChild();
     }
     return Element::InvalidElement;
@@ -83,7 +86,7 @@ class ListIndentProcessor : public BlockProcessor
 public:
     ListIndentProcessor(BlockParser *parser) :
 		BlockProcessor(parser),
-		INDENT_RE((boost::wformat(L"^(([ ]{%s})+)")%this->tab_length).str())
+		INDENT_RE(RegexCache::get((boost::wformat(L"^(([ ]{%s})+)")%this->tab_length).str()))
 	{}
 	~ListIndentProcessor(void)
 	{}
@@ -91,8 +94,9 @@ public:
     bool test(Element &parent, const std::wstring &block)
     {
         return block.substr(0, this->tab_length) == std::wstring(this->tab_length, L' ')
+                && ! Context::current().state.isstate(L"detabbed")
                 && ( std::find(this->ITEM_TYPES.begin(), this->ITEM_TYPES.end(), parent.getTagName()) != this->ITEM_TYPES.end()
-                || ( parent.child().size() > 0
+                || ( parent.hasChildren()
                      && std::find(this->LIST_TYPES.begin(), this->LIST_TYPES.end(), parent.getLastElementChild().getTagName()) != this->LIST_TYPES.end() )
                 );
 	}
@@ -106,14 +110,14 @@ public:
         Element sibling = result.get<1>();
         block = this->looseDetab(block, level);
 
-        this->parser->state.set(L"detabbed");
+        Context::current().state.set(L"detabbed");
         if ( std::find(this->ITEM_TYPES.begin(), this->ITEM_TYPES.end(), parent.getTagName()) != this->ITEM_TYPES.end() ) {
             //! It's possible that this parent has a 'ul' or 'ol' child list
             //! with a member.  If that is the case, then that should be the
             //! parent.  This is intended to catch the edge case of an indented
             //! list whose first member was parsed previous to this point
             //! see OListProcessor
-            if ( parent.child().size() > 0 && std::find(this->LIST_TYPES.begin(), this->LIST_TYPES.end(), parent.getLastElementChild().getTagName()) != this->LIST_TYPES.end() ) {
+            if ( parent.hasChildren() && std::find(this->LIST_TYPES.begin(), this->LIST_TYPES.end(), parent.getLastElementChild().getTagName()) != this->LIST_TYPES.end() ) {
                 std::list<std::wstring> new_blocks = {block};
                 Element new_parent = parent.getLastElementChild();
                 this->parser->parseBlocks(new_parent, new_blocks);
@@ -126,7 +130,7 @@ public:
             //! The sibling is a li. Use it as parent.
             std::list<std::wstring> new_blocks = {block};
             this->parser->parseBlocks(sibling, new_blocks);
-        } else if ( sibling.child().size() > 0 && std::find(this->ITEM_TYPES.begin(), this->ITEM_TYPES.end(), sibling.getLastElementChild().getTagName()) != this->ITEM_TYPES.end() ) {
+        } else if ( sibling.hasChildren() && std::find(this->ITEM_TYPES.begin(), this->ITEM_TYPES.end(), sibling.getLastElementChild().getTagName()) != this->ITEM_TYPES.end() ) {
             //! The parent is a list (``ol`` or ``ul``) which has children.
             //! Assume the last child li is the parent of this block.
             if ( sibling.getLastElementChild().hasText() ) {
@@ -138,7 +142,7 @@ public:
                 elem.removeText();
                 Element p(elem, L"p");
                 p.setText(text);
-                if ( elem.child().size() > 0 ) {
+                if ( elem.hasChildren() ) {
                     elem.insertBefore(p, elem.getFirstElementChild());
                 } else {
                     elem.append(p);
@@ -149,7 +153,7 @@ public:
         } else {
             this->create_item(sibling, block);
         }
-        this->parser->state.reset();
+        Context::current().state.reset();
     }
 
     /*!
@@ -157,8 +161,7 @@ public:
      */
     void create_item(Element &parent, const std::wstring &block)
     {
-        Element li(parent, L"li");
-        parent.append(li);
+        Element li = ElementBuilder(parent).append(L"li");
         std::list<std::wstring> new_blocks = {block};
         this->parser->parseBlocks(li, new_blocks);
     }
@@ -166,16 +169,16 @@ public:
     /*!
      * Get level of indent based on list level.
      */
-    boost::tuples::tuple<int, Element> get_level(Element &parent, const std::wstring &block)
+    boost::tuples::tuple<int, Element> get_level(Element parent, const std::wstring &block)
     {
         //! Get indent level
         int indent_level = 0;
         int level = 0;
         boost::wsmatch m;
-        if ( boost::regex_match(block, m, this->INDENT_RE) ) {
+        if ( boost::regex_search(block, m, this->INDENT_RE, boost::match_continuous) ) {
             indent_level = m.str(1).size()/this->tab_length;
         }
-        if ( this->parser->state.isstate(L"list") ) {
+        if ( Context::current().state.isstate(L"list") ) {
             //! We're in a tightlist - so we already are at correct parent.
             level = 1;
         } else {
@@ -232,7 +235,7 @@ public:
         std::wstring block = blocks.front();
         blocks.pop_front();
         std::wstring theRest;
-        if ( ! sibling.isNull() && sibling.getTagName() == L"pre" && sibling.child().size() > 0 && sibling.getFirstElementChild().getTagName() == L"code" ) {
+        if ( ! sibling.isNull() && sibling.getTag() == HtmlTag::pre && sibling.hasChildren() && sibling.getFirstElementChild().getTag() == HtmlTag::code ) {
             //! The previous block was a code block. As blank lines do not start
             //! new code blocks, append this block to the previous, adding back
             //! linebreaks removed from the split into a list.
@@ -266,7 +269,7 @@ class BlockQuoteProcessor : public BlockProcessor
 public:
     BlockQuoteProcessor(BlockParser *parser) :
         BlockProcessor(parser),
-        RE(L"(^|\\n)[ ]{0,3}>[ ]?(.*)")
+        RE(RegexCache::get(L"(^|\\n)[ ]{0,3}>[ ]?(.*)"))
     {}
 
     bool test(Element&, const std::wstring &block)
@@ -296,7 +299,7 @@ public:
         }
         Element sibling = this->lastChild(parent);
         Element quote = Element::InvalidElement;
-        if ( ! sibling.isNull() && sibling.getTagName() == L"blockquote" ) {
+        if ( ! sibling.isNull() && sibling.getTag() == HtmlTag::blockquote ) {
             //! Previous block was a blockquote so set that as this blocks parent
             quote = sibling;
         } else {
@@ -306,9 +309,9 @@ public:
         }
         //! Recursively parse block with blockquote as parent.
         //! change parser state so blockquotes embedded in lists use p tags
-        this->parser->state.set(L"blockquote");
+        Context::current().state.set(L"blockquote");
         this->parser->parseChunk(quote, block);
-        this->parser->state.reset();
+        Context::current().state.reset();
     }
 
     /*!
@@ -340,10 +343,10 @@ public:
     OListProcessor(BlockParser *parser) :
         BlockProcessor(parser),
         TAG(L"ol"),
-        RE(L"^[ ]{0,3}\\d+\\.[ ]+(.*)"),
-        CHILD_RE(L"^[ ]{0,3}((\\d+\\.)|[*+-])[ ]+(.*)"),
-        INDENT_RE(L"^[ ]{4,7}((\\d+\\.)|[*+-])[ ]+.*"),
-        STARTSWITH(L"1"),
+        RE(RegexCache::get(L"^[ ]{0,3}\\d+\\.[ ]+(.*)")),
+        CHILD_RE(RegexCache::get(L"^[ ]{0,3}((\\d+\\.)|[*+-])[ ]+(.*)")),
+        INDENT_RE(RegexCache::get(L"^[ ]{4,7}((\\d+\\.)|[*+-])[ ]+.*")),
+        INTEGER_RE(RegexCache::get(L"(\\d+)")),
         SIBLING_TAGS({L"ol", L"ul"})
     {}
     virtual ~OListProcessor()
@@ -359,7 +362,8 @@ public:
         //! Check fr multiple items in one block.
         std::wstring block = blocks.front();
         blocks.pop_front();
-        std::list<std::wstring> items = this->get_items(block);
+        std::wstring startswith = L"1";
+        std::list<std::wstring> items = this->get_items(block, startswith);
         Element sibling = this->lastChild(parent);
         Element lst = Element::InvalidElement;
 
@@ -368,7 +372,7 @@ public:
             lst = sibling;
             //! make sure previous item is in a p- if the item has text, then it
             //! it isn't in a p
-            if ( lst.child().size() > 0 && lst.getLastElementChild().hasText() ) {
+            if ( lst.hasChildren() && lst.getLastElementChild().hasText() ) {
                 //! since it's possible there are other children for this sibling,
                 //! we can't just SubElement the p, we need to insert it as the
                 //! first item
@@ -377,7 +381,7 @@ public:
                 std::wstring text = elem.text();
                 elem.removeText();
                 p.setText(text);
-                if ( elem.child().size() > 0 ) {
+                if ( elem.hasChildren() ) {
                     elem.insertBefore(p, elem.getFirstElementChild());
                 } else {
                     elem.append(p);
@@ -395,15 +399,14 @@ public:
             }
 
             //! parse first block differently as it gets wrapped in a p.
-            Element li(lst, L"li");
-            lst.append(li);
-            this->parser->state.set(L"looselist");
+            Element li = ElementBuilder(lst).append(L"li");
+            Context::current().state.set(L"looselist");
             std::wstring firstitem = items.front();
             items.pop_front();
             std::list<std::wstring> new_blocks = {firstitem};
             this->parser->parseBlocks(li, new_blocks);
-            this->parser->state.reset();
-        } else if ( parent.getTagName() == L"ol" || parent.getTagName() == L"ul" ) {
+            Context::current().state.reset();
+        } else if ( parent.getTag() == HtmlTag::ol || parent.getTag() == HtmlTag::ul ) {
             //! this catches the edge case of a multi-item indented list whose
             //! first item is in a blank parent-list item:
             //! * * subitem1
@@ -412,17 +415,17 @@ public:
             lst = parent;
         } else {
             //! This is a new list so create parent with appropriate tag.
-            lst = Element(parent, this->TAG);
-            parent.append(lst);
+            lst = ElementBuilder(parent).append(this->TAG);
             //! Check if a custom start integer is set
-            if ( ! this->parser->markdown->lazy_ol() && this->STARTSWITH != L"1" ) {
-                lst.setAttribute(L"start", this->STARTSWITH);
+            if ( ! this->parser->markdown->lazy_ol() && startswith != L"1" ) {
+                lst.setAttribute(L"start", startswith);
             }
         }
 
-        this->parser->state.set(L"list");
+        Context::current().state.set(L"list");
         //! Loop through items in block, recursively parsing each with the
         //! appropriate parent.
+        ElementBuilder builder(lst);
         for ( const std::wstring &item : items ) {
             std::list<std::wstring> new_blocks = {item};
             if ( item.substr(0, this->tab_length) == std::wstring(this->tab_length, L' ') ) {
@@ -431,18 +434,22 @@ public:
                 this->parser->parseBlocks(new_parent, new_blocks);
             } else {
                 //! New item. Create li and parse with it as parent
-                Element li = Element(lst, L"li");
-                lst.append(li);
+                Element li = builder.append(L"li");
                 this->parser->parseBlocks(li, new_blocks);
             }
         }
-        this->parser->state.reset();
+        Context::current().state.reset();
     }
 
     /*!
      * Break a block into list items.
+     *
+     * The integer (python string) with which the list starts is stored in
+     * `startswith`. Eg: If list is intialized as)
+     *   3. Item
+     * The ol tag will get starts="3" attribute
      */
-    std::list<std::wstring> get_items(const std::wstring &block)
+    std::list<std::wstring> get_items(const std::wstring &block, std::wstring &startswith)
     {
         std::list<std::wstring> items;
         std::list<std::wstring> lines;
@@ -454,11 +461,10 @@ public:
                 //! Check first item for the start index
                 if ( items.empty() && this->TAG == L"ol" ) {
                     //! Detect the integer value of first list item
-                    boost::wregex INTEGER_RE(L"(\\d+)");
                     boost::wsmatch im;
                     std::wstring regexTmp = m.str(1);
-                    boost::regex_search(regexTmp, im, INTEGER_RE);
-                    this->STARTSWITH = im.str();
+                    boost::regex_search(regexTmp, im, this->INTEGER_RE);
+                    startswith = im.str();
                 }
                 //! Append to the list
                 items.push_back(m.str(3));
@@ -488,11 +494,8 @@ private:
     const boost::wregex CHILD_RE;
     //! Detect indented (nested) items of either type
     const boost::wregex INDENT_RE;
-    //! The integer (python string) with which the lists starts (default=1)
-    //! Eg: If list is intialized as)
-    //!   3. Item
-    //! The ol tag will get starts="3" attribute
-    std::wstring STARTSWITH;
+    //! Detect the integer value of first list item
+    const boost::wregex INTEGER_RE;
     //! List of allowed sibling tags.
     const std::set<std::wstring> SIBLING_TAGS;
 
@@ -505,7 +508,7 @@ public:
         OListProcessor(parser)
     {
         OListProcessor::TAG = L"ul";
-        OListProcessor::RE = boost::wregex(L"^[ ]{0,3}[*+-][ ]+(.*)");
+        OListProcessor::RE = RegexCache::get(L"^[ ]{0,3}[*+-][ ]+(.*)");
     }
 
 };
@@ -518,7 +521,7 @@ class HashHeaderProcessor : public BlockProcessor
 public:
     HashHeaderProcessor(BlockParser *parser) :
         BlockProcessor(parser),
-        RE(L"(^|\\n)(?<level>#{1,6})(?<header>.*?)#*(\\n|$)")
+        RE(RegexCache::get(L"(^|\\n)(?<level>#{1,6})(?<header>.*?)#*(\\n|$)"))
     {}
 
     bool test(Element&, const std::wstring &block)
@@ -569,7 +572,7 @@ class SetextHeaderProcessor : public BlockProcessor
 public:
     SetextHeaderProcessor(BlockParser *parser) :
         BlockProcessor(parser),
-        RE(L"(?m)^.*?\\n[=-]+[ ]*(\\n|$)")
+        RE(RegexCache::get(L"(?m)^.*?\\n[=-]+[ ]*(\\n|$)"))
     {}
 
     bool test(Element&, const std::wstring &block)
@@ -621,32 +624,25 @@ class HRProcessor : public BlockProcessor
 public:
     HRProcessor(BlockParser *parser) :
         BlockProcessor(parser),
-        SEARCH_RE(L"(?m)^[ ]{0,3}((-+[ ]{0,2}){3,}|(_+[ ]{0,2}){3,}|(\\*+[ ]{0,2}){3,})[ ]*"),
-        match()
+        SEARCH_RE(RegexCache::get(L"(?m)^[ ]{0,3}((-+[ ]{0,2}){3,}|(_+[ ]{0,2}){3,}|(\\*+[ ]{0,2}){3,})[ ]*"))
     {}
 
     bool test(Element&, const std::wstring &block)
     {
-        //! No atomic grouping in python so we simulate it here for performance.
-        //! The regex only matches what would be in the atomic group - the HR.
-        //! Then check if we are at end of block or if next char is a newline.
         boost::wsmatch m;
-        if ( boost::regex_search(block, m, this->SEARCH_RE)
-             && ( static_cast<unsigned int>( m.position()+m.length() ) == block.size()
-                  || block.at(m.position()+m.length()) == L'\n' ) ) {
-            //! Save match object on class instance so we can use it later.
-            this->match = m;
-            return true;
-        }
-        return false;
+        return this->search(block, m);
     }
 
     void run(Element &parent, std::list<std::wstring>& blocks)
     {
         std::wstring block = blocks.front();
         blocks.pop_front();
+        //! The processor is shared between threads, so the match found by
+        //! test() is not kept on the instance; search the block again.
+        boost::wsmatch match;
+        this->search(block, match);
         //! Check for lines in block before hr.
-        std::wstring prelines = boost::algorithm::trim_right_copy_if(block.substr(0, this->match.position()), [](wchar_t ch) -> bool { return ch == L'\n'; });
+        std::wstring prelines = boost::algorithm::trim_right_copy_if(block.substr(0, match.position()), [](wchar_t ch) -> bool { return ch == L'\n'; });
         if ( ! prelines.empty() ) {
             //! Recursively parse lines before hr so they get parsed first.
             std::list<std::wstring> new_blocks = {prelines};
@@ -656,7 +652,7 @@ public:
         Element hr(parent, L"hr");
         parent.append(hr);
         //! check for lines in block after hr.
-        int begin = this->match.position()+this->match.length();
+        int begin = match.position()+match.length();
         std::wstring postlines = boost::algorithm::trim_left_copy_if(block.substr(begin, block.size()-begin), [](wchar_t ch) -> bool { return ch == L'\n'; });
         if ( ! postlines.empty() ) {
             //! Add lines after hr to master blocks for later parsing.
@@ -664,10 +660,20 @@ public:
         }
     }
 
+private:
+    bool search(const std::wstring &block, boost::wsmatch &m) const
+    {
+        //! No atomic grouping in python so we simulate it here for performance.
+        //! The regex only matches what would be in the atomic group - the HR.
+        //! Then check if we are at end of block or if next char is a newline.
+        return boost::regex_search(block, m, this->SEARCH_RE)
+               && ( static_cast<unsigned int>( m.position()+m.length() ) == block.size()
+                    || block.at(m.position()+m.length()) == L'\n' );
+    }
+
 private:
     //! Detect hr on any line of a block.
     boost::wregex SEARCH_RE;
-    boost::wsmatch match;
 
 };
 
@@ -703,7 +709,7 @@ public:
             }
         }
         Element sibling = this->lastChild(parent);
-        if ( ! sibling.isNull() && sibling.getTagName() == L"pre" && sibling.child().size() > 0 && sibling.getFirstElementChild().getTagName() == L"code" ) {
+        if ( ! sibling.isNull() && sibling.getTag() == HtmlTag::pre && sibling.hasChildren() && sibling.getFirstElementChild().getTag() == HtmlTag::code ) {
             //! Last block is a codeblock. Append to preserve whitespace.
             std::wstring codeText = sibling.getFirstElementChild().text();
             sibling.getFirstElementChild().setText((boost::wformat(L"%s%s")%codeText%filler).str());
@@ -733,7 +739,7 @@ public:
         blocks.pop_front();
         if ( ! boost::algorithm::trim_copy(block).empty() ) {
             //! Not a blank block. Add to parent, otherwise throw it away.
-            if ( this->parser->state.isstate(L"list") ) {
+            if ( Context::current().state.isstate(L"list") ) {
                 //! The parent is a tight-list.
                 //!
                 //! Check for any children. This will likely only happen in a
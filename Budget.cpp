@@ -0,0 +1,99 @@
+/*
+ * Budget.cpp
+ *
+ *  Created on: 2026/10/17
+ *      Author: mugwort_rc
+ */
+
+#include "Budget.h"
+
+#include <boost/format.hpp>
+
+#include "ElementTree.h"
+
+namespace markdown{
+
+namespace {
+
+std::size_t utf8_size(const std::wstring& text)
+{
+    std::size_t size = 0;
+    for ( wchar_t ch : text ) {
+        unsigned long code = static_cast<unsigned long>(ch);
+        if ( code < 0x80 ) {
+            size += 1;
+        } else if ( code < 0x800 ) {
+            size += 2;
+        } else if ( code >= 0xD800 && code <= 0xDBFF ) {
+            size += 4;  //!< the low surrogate adds nothing
+        } else if ( code >= 0xDC00 && code <= 0xDFFF ) {
+            size += 0;
+        } else if ( code < 0x10000 ) {
+            size += 3;
+        } else {
+            size += 4;
+        }
+    }
+    return size;
+}
+
+} // end of anonymous namespace
+
+BudgetMeter::BudgetMeter(void) :
+    budget(), deadline(), _steps(0), _depth(0), elements_base(0)
+{}
+
+void BudgetMeter::start(const Budget& budget, const std::wstring& source)
+{
+    this->budget = budget;
+    this->deadline = std::chrono::steady_clock::now() + budget.timeout;
+    this->_steps = 0;
+    this->_depth = 0;
+    this->elements_base = Element::createdCount();
+    if ( budget.max_input_bytes > 0 ) {
+        //! every character takes at least one byte
+        if ( source.size() > budget.max_input_bytes || utf8_size(source) > budget.max_input_bytes ) {
+            throw BudgetExceeded(BudgetExceeded::input_bytes,
+                                 (boost::format("markdown: input exceeds %d bytes") % budget.max_input_bytes).str());
+        }
+    }
+}
+
+void BudgetMeter::step(std::size_t count)
+{
+    this->_steps += count;
+    if ( this->budget.max_regex_steps > 0 && this->_steps > this->budget.max_regex_steps ) {
+        throw BudgetExceeded(BudgetExceeded::regex_steps,
+                             (boost::format("markdown: more than %d regex steps") % this->budget.max_regex_steps).str());
+    }
+    if ( this->budget.max_elements > 0 && this->elements() > this->budget.max_elements ) {
+        throw BudgetExceeded(BudgetExceeded::elements,
+                             (boost::format("markdown: more than %d elements") % this->budget.max_elements).str());
+    }
+    if ( this->budget.timeout != std::chrono::steady_clock::duration::zero() && std::chrono::steady_clock::now() > this->deadline ) {
+        throw BudgetExceeded(BudgetExceeded::timeout, "markdown: conversion timed out");
+    }
+}
+
+std::size_t BudgetMeter::elements(void) const
+{
+    return Element::createdCount() - this->elements_base;
+}
+
+BudgetMeter::Nesting::Nesting(BudgetMeter& meter) :
+    meter(meter)
+{
+    ++this->meter._depth;
+    if ( this->meter.budget.max_depth > 0 && this->meter._depth > this->meter.budget.max_depth ) {
+        --this->meter._depth;
+        throw BudgetExceeded(BudgetExceeded::depth,
+                             (boost::format("markdown: nesting deeper than %d") % this->meter.budget.max_depth).str());
+    }
+}
+
+BudgetMeter::Nesting::~Nesting(void)
+{
+    --this->meter._depth;
+}
+
+} // end of namespace markdown
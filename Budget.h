@@ -0,0 +1,134 @@
+/*
+ * Budget.h
+ *
+ *  Created on: 2026/10/17
+ *      Author: mugwort_rc
+ */
+
+#ifndef BUDGET_H_
+#define BUDGET_H_
+
+#include <chrono>
+#include <cstddef>
+#include <stdexcept>
+#include <string>
+
+namespace markdown{
+
+/*!
+ * Resource limits of a single conversion.
+ *
+ * A zero limit is unlimited, which is the default. The limits are checked
+ * cooperatively by the block parser, the inline processor and the html
+ * block preprocessor between two regex match attempts, so a conversion
+ * overshoots a limit by at most one step before it is aborted with
+ * BudgetExceeded. A single match attempt on a long block is not
+ * interrupted.
+ *
+ * Keyword arguments:
+ *
+ * * timeout: Wall-clock time allowed from the start of the conversion.
+ * * max_input_bytes: Size of the source encoded as UTF-8.
+ * * max_depth: Nesting of blocks (blockquotes, lists) and inline patterns.
+ * * max_elements: Number of elements created.
+ * * max_regex_steps: Number of regex match attempts by the block
+ *    processors, the inline patterns and the html tag search.
+ *
+ */
+struct Budget
+{
+    Budget(void) :
+        timeout(std::chrono::steady_clock::duration::zero()),
+        max_input_bytes(0), max_depth(0), max_elements(0), max_regex_steps(0)
+    {}
+
+    std::chrono::steady_clock::duration timeout;
+    std::size_t max_input_bytes;
+    std::size_t max_depth;
+    std::size_t max_elements;
+    std::size_t max_regex_steps;
+};
+
+/*!
+ * Thrown out of Markdown::convert() when a Budget limit is exceeded.
+ */
+class BudgetExceeded : public std::runtime_error
+{
+public:
+    enum Limit
+    {
+        timeout,
+        input_bytes,
+        depth,
+        elements,
+        regex_steps
+    };
+
+public:
+    BudgetExceeded(Limit limit, const std::string& what) :
+        std::runtime_error(what), _limit(limit)
+    {}
+
+    Limit limit(void) const
+    { return this->_limit; }
+
+private:
+    Limit _limit;
+
+};
+
+/*!
+ * Usage of a Budget during one conversion.
+ */
+class BudgetMeter
+{
+public:
+    BudgetMeter(void);
+
+    /*!
+     * Start metering a conversion of `source`.
+     *
+     * Throws BudgetExceeded if the source is already too large.
+     */
+    void start(const Budget& budget, const std::wstring& source);
+
+    /*!
+     * Count `count` regex match attempts and check the deadline and the
+     * number of elements created so far.
+     */
+    void step(std::size_t count=1);
+
+    /*!
+     * One level deeper for the lifetime of the scope.
+     */
+    class Nesting
+    {
+    public:
+        Nesting(BudgetMeter& meter);
+        ~Nesting(void);
+
+    private:
+        Nesting(const Nesting&);
+        Nesting& operator =(const Nesting&);
+
+    private:
+        BudgetMeter& meter;
+
+    };
+
+    std::size_t steps(void) const
+    { return this->_steps; }
+    std::size_t elements(void) const;
+
+private:
+    Budget budget;
+    std::chrono::steady_clock::time_point deadline;
+    std::size_t _steps;
+    std::size_t _depth;
+    std::size_t elements_base;  //!< Element::createdCount() at start()
+
+};
+
+} // end of namespace markdown
+
+#endif // BUDGET_H_
@@ -0,0 +1,64 @@
+/*
+ * Context.cpp
+ *
+ *  Created on: 2026/10/17
+ *      Author: mugwort_rc
+ */
+
+#include "Context.h"
+
+#include <stdexcept>
+
+namespace markdown{
+
+namespace {
+
+thread_local Context* current_context = nullptr;
+
+} // end of anonymous namespace
+
+Context::Context(void) :
+    references(), htmlStash(), stashed_nodes(), state(),
+    class_root(ElementTree::InvalidElementTree),
+    outputBuffer(), meter(),
+    document(ElementTree::InvalidElementTree)
+{}
+
+void Context::reset(void)
+{
+    this->references.clear();
+    this->htmlStash.reset();
+    this->stashed_nodes.clear();
+    this->state = State();
+    this->class_root = ElementTree::InvalidElementTree;
+    this->outputBuffer.clear();
+}
+
+ElementTree Context::newDocument(const std::wstring& root)
+{
+    if ( ! this->document.recycle(root) ) {
+        this->document = ElementTree(root);
+    }
+    return this->document;
+}
+
+Context& Context::current(void)
+{
+    if ( current_context == nullptr ) {
+        throw std::logic_error("markdown::Context::current() called outside of a conversion");
+    }
+    return *current_context;
+}
+
+Context::Scope::Scope(Context& context) :
+    previous(current_context)
+{
+    current_context = &context;
+}
+
+Context::Scope::~Scope(void)
+{
+    current_context = this->previous;
+}
+
+} // end of namespace markdown
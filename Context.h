@@ -0,0 +1,114 @@
+/*
+ * Context.h
+ *
+ *  Created on: 2026/10/17
+ *      Author: mugwort_rc
+ */
+
+#ifndef CONTEXT_H_
+#define CONTEXT_H_
+
+#include <map>
+#include <string>
+#include <utility>
+
+#include "BlockParser.h"
+#include "Budget.h"
+#include "ElementTree.h"
+#include "Profiler.h"
+#include "TreeProcessors.h"
+#include "util.h"
+
+namespace markdown{
+
+/*!
+ * Mutable state of a single conversion.
+ *
+ * A Markdown instance only holds the compiled processors and its
+ * configuration; everything a conversion writes to lives here. One
+ * Markdown can therefore be shared by any number of threads as long as
+ * each conversion runs with its own Context.
+ *
+ * A Context may be reused for consecutive conversions on one thread;
+ * reset() keeps the capacity of its buffers, and the document of the
+ * previous conversion is recycled by newDocument().
+ *
+ */
+class Context
+{
+public:
+    typedef std::pair<std::wstring, std::wstring> ReferenceItem;
+    typedef std::map<std::wstring, ReferenceItem> Reference;
+
+public:
+    Context(void);
+
+    /*!
+     * Forget the state of the previous conversion.
+     */
+    void reset(void);
+
+    /*!
+     * The context of the conversion running on this thread.
+     *
+     * Processors reach their per-document state through this. Throws
+     * std::logic_error when called outside of Markdown::convert().
+     */
+    static Context& current(void);
+
+    /*!
+     * An empty document with a `root` element for this conversion.
+     *
+     * The document of the previous call is emptied and returned again
+     * when nothing else holds it any more, so a context converting one
+     * text after another keeps reusing the same storage.
+     */
+    ElementTree newDocument(const std::wstring& root);
+
+    /*!
+     * Install a context as the current one for the lifetime of the scope.
+     *
+     * The previous context is restored on exit, so a processor may run a
+     * nested conversion.
+     */
+    class Scope
+    {
+    public:
+        Scope(Context& context);
+        ~Scope(void);
+
+    private:
+        Scope(const Scope&);
+        Scope& operator =(const Scope&);
+
+    private:
+        Context* previous;
+
+    };
+
+public:
+    Reference references;                    //!< link references collected by the preprocessor
+    HtmlStash htmlStash;                     //!< raw html blocks
+    TreeProcessor::StashNodes stashed_nodes; //!< inline nodes waiting for their placeholders
+    State state;                             //!< nesting state of the block parser
+    ElementTree class_root;                  //!< document the inline nodes are created in
+
+    std::wstring outputBuffer;  //!< reused by the stream and chunk sinks
+    BudgetMeter meter;          //!< usage of Markdown::budget() by this conversion
+
+#ifdef USE_PROFILING
+    Profile profile;  //!< accumulated over every conversion; not cleared by reset()
+#endif
+
+private:
+    ElementTree document;  //!< returned by the last newDocument()
+
+private:
+    Context(const Context&);
+    Context& operator =(const Context&);
+
+};
+
+} // end of namespace markdown
+
+#endif // CONTEXT_H_
@@ -7,7 +7,15 @@
 
 #include "ElementTree.h"
 
-#include <boost/scoped_ptr.hpp>
+#ifndef USE_ARENA_TREE
+
+#include <algorithm>
+#include <cstdint>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <boost/scoped_array.hpp>
 
 #include <xercesc/util/XMLUniDefs.hpp>
 #include <xercesc/dom/DOMDocument.hpp>
@@ -17,167 +25,223 @@
 #include <xercesc/dom/DOMNamedNodeMap.hpp>
 #include <xercesc/dom/DOMNodeList.hpp>
 #include <xercesc/dom/DOMText.hpp>
-#include <xercesc/util/XMLUTF8Transcoder.hpp>
+#include <xercesc/util/XMLString.hpp>
+
+#include "Unicode.h"
+
+namespace {
 
-#if defined(USE_CPP11)
-#include <codecvt>
-#elif defined(USE_QT)
-#include <QString>
-#endif
+thread_local std::size_t created_elements = 0;
 
-//! from XQilla
+} // end of anonymous namespace
 
+/*!
+ * A wide string as a null-terminated XMLCh string for the DOM calls.
+ *
+ * Names, attributes and short texts are transcoded into the inline
+ * buffer; only longer texts allocate, once.
+ */
 class XStr
 {
-public :
-  XStr(const char* const toTranscode, XERCES_CPP_NAMESPACE_QUALIFIER MemoryManager *mm = 0)
-      : str_(0),
-        mm_(mm)
+public:
+    explicit XStr(const std::wstring& toTranscode) :
+        str_(buffer_)
     {
-      if(toTranscode == 0) {
-        str_ = mm_ ? (XMLCh*)mm_->allocate(1 * sizeof(XMLCh)) : new XMLCh[1];
-        str_[0] = 0;
-      }
-      else {
-        xercesc::XMLUTF8Transcoder t(0, 512);
-        size_t l = xercesc::XMLString::stringLen(toTranscode);
-        const size_t needed = l * 2 + 1; // 2 chars per byte is the worst case, + '\0'
-        str_ = mm_ ? (XMLCh*)mm_->allocate(needed * sizeof(XMLCh)) : new XMLCh[needed];
-
-        boost::scoped_ptr<unsigned char> charSizes(new unsigned char[needed]);
-
-        XMLSize_t bytesEaten = 0;
-        t.transcodeFrom((const XMLByte*)toTranscode, l+1, str_,
-                        needed, bytesEaten, charSizes.get());
-      }
-    }
-  ~XStr()
-  {
-    if(str_) {
-      if(mm_) mm_->deallocate(str_);
-      else delete [] str_;
-    }
-  }
-
-  const XMLCh *str() const
-  {
-    return str_;
-  }
-
-  XMLCh *adopt()
-  {
-    XMLCh *result = (XMLCh*)str_;
-    str_ = 0;
-    return result;
-  }
+        //! surrogate pairs are the worst case, + '\0'
+        const std::size_t needed = toTranscode.size() * 2 + 1;
+        if ( needed > sizeof(buffer_) / sizeof(XMLCh) ) {
+            heap_.reset(new XMLCh[needed]);
+            str_ = heap_.get();
+        }
+        *markdown::utf16_encode(toTranscode.data(), toTranscode.size(), str_) = 0;
+    }
+
+    const XMLCh* str(void) const
+    {
+        return str_;
+    }
+
+private:
+    XStr(const XStr&);
+    XStr& operator =(const XStr&);
+
+private:
+    XMLCh  buffer_[128];
+    boost::scoped_array<XMLCh> heap_;
+    XMLCh* str_;
 
-private :
-  XMLCh *str_;
-  XERCES_CPP_NAMESPACE_QUALIFIER MemoryManager *mm_;
 };
 
 #define X(strg) XStr(strg).str()
 
 namespace markdown{
 
-#if defined(USE_CPP11)
-
 std::wstring wconvert(const std::string& src)
 {
-    std::wstring_convert<std::codecvt_utf8_utf16<wchar_t>> convert;
-    return convert.from_bytes(src);
+    return utf8_decode(src);
 }
 
 std::string convert(const std::wstring& src)
 {
-    std::wstring_convert<std::codecvt_utf8_utf16<wchar_t>> convert;
-    return convert.to_bytes(src);
+    return utf8_encode(src);
 }
 
-#elif defined(USE_QT)
+std::string convert(const XMLCh* src)
+{
+    std::wstring wide;
+    utf16_decode(src, xercesc::XMLString::stringLen(src), wide);
+    return utf8_encode(wide);
+}
 
-std::wstring wconvert(const std::string& src)
+std::wstring wconvert(const XMLCh* src)
 {
-    return QString::fromUtf8(src.data()).toStdWString();
+    //! UTF-16 to wchar_t directly, without going through UTF-8
+    std::wstring result;
+    utf16_decode(src, xercesc::XMLString::stringLen(src), result);
+    return result;
 }
 
-std::string convert(const std::wstring& src)
+namespace {
+
+//! ElementImpl is never defined: handles hold the DOMElement itself.
+inline xercesc::DOMElement* dom(ElementImpl* elem)
 {
-    return QString::fromStdWString(src).toUtf8().constData();
+    return reinterpret_cast<xercesc::DOMElement*>(elem);
+}
+inline ElementImpl* handle(xercesc::DOMElement* elem)
+{
+    return reinterpret_cast<ElementImpl*>(elem);
 }
 
-#else
+//! user data key of the interned tag name, stored as atom + 1 so that an
+//! element without it reads as null
+const XMLCh TAG_ATOM_KEY[] = {xercesc::chLatin_t, xercesc::chLatin_a, xercesc::chLatin_g, xercesc::chNull};
 
-std::wstring wconvert(const std::string& src)
+//! user data key of the TagIndex of a document, set by the ElementTreeImpl
+//! that owns it
+const XMLCh TAG_INDEX_KEY[] = {xercesc::chLatin_i, xercesc::chLatin_n, xercesc::chLatin_d, xercesc::chLatin_e, xercesc::chLatin_x, xercesc::chNull};
+
+//! user data key of the AttributeCache of a document, set by the
+//! ElementTreeImpl that owns it
+const XMLCh ATTRIBUTES_KEY[] = {xercesc::chLatin_a, xercesc::chLatin_t, xercesc::chLatin_t, xercesc::chLatin_r, xercesc::chNull};
+
+//! user data key of the document's spare parent for detached elements
+//! given a tail
+const XMLCh DUMMY_KEY[] = {xercesc::chLatin_d, xercesc::chLatin_u, xercesc::chLatin_m, xercesc::chLatin_m, xercesc::chLatin_y, xercesc::chNull};
+
+/*!
+ * Every element created in or imported into a document, by tag,
+ * attached or not. Xerces keeps removed nodes until the document is
+ * released, so the pointers stay valid as long as the index, and nothing
+ * is ever dropped from it before recycle().
+ *
+ * A query for a tag therefore walks every element ever created with it
+ * up to the root, detached ones included, and sorts the m that are below
+ * the queried element: O(created * depth + m log m). It beats walking the
+ * whole tree for rare tags, not for tags most elements have.
+ */
+typedef std::unordered_map<HtmlTag::Atom, std::vector<xercesc::DOMElement*> > TagIndex;
+
+HtmlTag::Atom tag_atom(xercesc::DOMElement* elem)
 {
-    std::wstring result;
-    result.resize(src.size());
-    mbstowcs(&result[0], &src[0], src.size());
-    return result;
+    std::uintptr_t cached = reinterpret_cast<std::uintptr_t>(elem->getUserData(TAG_ATOM_KEY));
+    if ( cached == 0 ) {
+        //! imported copies start without it
+        cached = HtmlTag::intern(wconvert(elem->getTagName())) + 1;
+        elem->setUserData(TAG_ATOM_KEY, reinterpret_cast<void*>(cached), nullptr);
+    }
+    return static_cast<HtmlTag::Atom>(cached - 1);
 }
 
-std::string convert(const std::wstring& src)
+TagIndex* tag_index(xercesc::DOMDocument* doc)
 {
-    std::string result;
-    result.resize(src.size()*4);
-    wcstombs(&result[0], &src[0], src.size());
-    return std::string(result.c_str());
+    return static_cast<TagIndex*>(doc->getUserData(TAG_INDEX_KEY));
 }
 
-#endif
+/*!
+ * The attributes of the elements read through Element::attribute(),
+ * transcoded and sorted by name once per element; Xerces keeps no order
+ * worth relying on. An element's entry is dropped when it gets an
+ * attribute set.
+ */
+typedef std::vector<std::pair<std::wstring, std::wstring> > SortedAttributes;
+typedef std::unordered_map<const xercesc::DOMElement*, SortedAttributes> AttributeCache;
 
-std::string convert(const XMLCh* src)
+AttributeCache* attribute_cache(xercesc::DOMDocument* doc)
 {
-    const unsigned int length = 1024;
-    xercesc::XMLUTF8Transcoder transcoder(nullptr, length);
+    return static_cast<AttributeCache*>(doc->getUserData(ATTRIBUTES_KEY));
+}
 
-    const XMLSize_t size = xercesc::XMLString::stringLen(src);
-    XMLSize_t eaten = 0, eated = 0;
-    std::string result;
-    boost::scoped_ptr<unsigned char> buffer(new unsigned char[length+1]);
-    while ( size > eated ) {
-        XMLSize_t r_size = transcoder.transcodeTo(src+eated, size-eated, buffer.get(), length, eaten, xercesc::XMLTranscoder::UnRep_RepChar);
-        result.append(reinterpret_cast<char*>(buffer.get()), r_size);
-        eated += eaten;
+void sort_attributes(xercesc::DOMElement* elem, SortedAttributes& result)
+{
+    xercesc::DOMNamedNodeMap* attrs = elem->getAttributes();
+    result.resize(attrs->getLength());
+    for ( XMLSize_t i = 0; i < attrs->getLength(); ++i ) {
+        xercesc::DOMNode* attr = attrs->item(i);
+        result[i].first.clear();
+        result[i].second.clear();
+        utf16_decode(attr->getNodeName(), xercesc::XMLString::stringLen(attr->getNodeName()), result[i].first);
+        utf16_decode(attr->getNodeValue(), xercesc::XMLString::stringLen(attr->getNodeValue()), result[i].second);
     }
-    return result;
+    std::sort(result.begin(), result.end(), [](const SortedAttributes::value_type& a, const SortedAttributes::value_type& b){
+        return a.first < b.first;
+    });
 }
 
-std::wstring wconvert(const XMLCh* src)
+//! add `elem` and the elements below it to the index of `doc`
+void index_elements(xercesc::DOMDocument* doc, xercesc::DOMElement* elem)
 {
-    std::string buff = convert(src);
-    return wconvert(buff);
+    TagIndex* index = tag_index(doc);
+    if ( index == nullptr ) {
+        return;
+    }
+    (*index)[tag_atom(elem)].push_back(elem);
+    for ( xercesc::DOMElement* child = elem->getFirstElementChild(); child; child = child->getNextElementSibling() ) {
+        index_elements(doc, child);
+    }
 }
 
-class ElementImpl
+xercesc::DOMElement* create_element(xercesc::DOMDocument* doc, const std::wstring& name)
 {
-public:
-    ElementImpl(xercesc::DOMElement *elem) :
-        _elem(elem)
-    {}
-    xercesc::DOMElement* ptr(void) const
-    {
-        return this->_elem;
-    }
-    void update(xercesc::DOMElement *repl)
-    {
-        this->_elem = repl;
+    xercesc::DOMElement* elem = doc->createElement(X(name));
+    const std::uintptr_t cached = HtmlTag::intern(name) + 1;
+    elem->setUserData(TAG_ATOM_KEY, reinterpret_cast<void*>(cached), nullptr);
+    if ( TagIndex* index = tag_index(doc) ) {
+        (*index)[static_cast<HtmlTag::Atom>(cached - 1)].push_back(elem);
     }
+    return elem;
+}
 
-private:
-    xercesc::DOMElement* _elem;
+//! `node` itself, or a deep copy of it if it belongs to another document
+xercesc::DOMNode* import_node(xercesc::DOMDocument* doc, xercesc::DOMNode* node)
+{
+    if ( node == nullptr || doc->isSameNode(node->getOwnerDocument()) ) {
+        return node;
+    }
+    return doc->importNode(node, true);
+}
 
-};
+} // end of anonymous namespace
 
 class ElementTreeImpl
 {
 public:
-    ElementTreeImpl(xercesc::DOMDocument *doc) :
-        _doc(doc)
-    {}
+    /*!
+     * Keyword arguments:
+     *
+     * * doc: The document.
+     * * owner: Release the document on destruction.
+     */
+    ElementTreeImpl(xercesc::DOMDocument *doc, bool owner=true) :
+        _doc(doc), _owner(owner), _tags(), _attributes()
+    {
+        if ( this->_doc && this->_owner ) {
+            this->adopt();
+        }
+    }
     ~ElementTreeImpl(void)
     {
-        if ( this->_doc ) {
+        if ( this->_doc && this->_owner ) {
             this->_doc->release();
         }
     }
@@ -185,53 +249,83 @@ public:
     {
         return this->_doc;
     }
+    bool owner(void) const
+    {
+        return this->_owner;
+    }
+
+    /*!
+     * Replace the document by an empty one. Xerces only frees the nodes of
+     * a document with the document, so it is the index that is kept.
+     */
+    void recycle(const std::wstring &root)
+    {
+        xercesc::DOMDocument* doc = create_document(root);
+        this->_doc->release();
+        this->_doc = doc;
+        for ( TagIndex::value_type& tagged : this->_tags ) {
+            tagged.second.clear();
+        }
+        this->_attributes.clear();
+        this->adopt();
+    }
 
 public:
     static boost::shared_ptr<ElementTreeImpl> generate(const std::wstring &root)
+    {
+        return boost::shared_ptr<ElementTreeImpl>(new ElementTreeImpl(create_document(root)));
+    }
+
+private:
+    static xercesc::DOMDocument* create_document(const std::wstring &root)
     {
         const XMLCh LS[] = {xercesc::chLatin_L, xercesc::chLatin_S, xercesc::chNull};
         xercesc::DOMImplementation* impl = xercesc::DOMImplementationRegistry::getDOMImplementation(LS);
-        return boost::shared_ptr<ElementTreeImpl>(new ElementTreeImpl(impl->createDocument(nullptr, X(convert(root).c_str()), nullptr)));
+        return impl->createDocument(nullptr, X(root), nullptr);
+    }
+    void adopt(void)
+    {
+        this->_doc->setUserData(TAG_INDEX_KEY, &this->_tags, nullptr);
+        this->_doc->setUserData(ATTRIBUTES_KEY, &this->_attributes, nullptr);
+        index_elements(this->_doc, this->_doc->getDocumentElement());
     }
 
 private:
     xercesc::DOMDocument* _doc;
+    bool _owner;
+    TagIndex _tags;
+    AttributeCache _attributes;
 
 };
 
 ElementTree ElementTree::InvalidElementTree(ElementTree::Impl(new ElementTreeImpl(nullptr)));
-Element Element::InvalidElement(Element::Impl(new ElementImpl(nullptr)));
+Element Element::InvalidElement(nullptr);
 
-Element::Element(const Element::Impl &impl) :
-    _impl(impl)
+std::size_t Element::createdCount(void)
+{
+    return created_elements;
+}
+
+Element::Element(ElementImpl* elem) :
+    _impl(elem)
 {}
 Element::Element(const ElementTree& doc) :
-    _impl(new ElementImpl(doc._impl->ptr()->getDocumentElement()))
+    _impl(handle(doc._impl->ptr()->getDocumentElement()))
 {}
 Element::Element(const ElementTree& doc, const std::wstring &name) :
-    _impl(new ElementImpl(doc._impl->ptr()->createElement(X(convert(name).c_str()))))
-{}
-Element::Element(const Element &parent, const std::wstring &name) :
-    _impl(new ElementImpl(parent._impl->ptr()->getOwnerDocument()->createElement(X(convert(name).c_str()))))
-{}
-Element::Element(const Element &copy) :
-    _impl(copy._impl)
-{}
-Element::Element(Element &&move) :
-    _impl(move._impl)
+    _impl(handle(create_element(doc._impl->ptr(), name)))
 {
-    move._impl.reset();
+    ++created_elements;
 }
-
-Element& Element::operator =(const Element& rhs)
+Element::Element(const Element &parent, const std::wstring &name) :
+    _impl(handle(create_element(dom(parent._impl)->getOwnerDocument(), name)))
 {
-    this->_impl = rhs._impl;
-    return *this;
+    ++created_elements;
 }
 
 bool Element::operator ==(const Element& rhs) const
 {
-    return this->_impl->ptr()->isSameNode(rhs._impl->ptr());
+    return dom(this->_impl)->isSameNode(dom(rhs._impl));
 }
 
 bool Element::operator !=(const Element& rhs) const
@@ -241,98 +335,162 @@ bool Element::operator !=(const Element& rhs) const
 
 ElementTree Element::getOwnerDocument(void) const
 {
-    return ElementTree(boost::shared_ptr<ElementTreeImpl>(new ElementTreeImpl(this->_impl->ptr()->getOwnerDocument())));
+    //! the document is owned by the ElementTree that created it
+    return ElementTree(boost::shared_ptr<ElementTreeImpl>(new ElementTreeImpl(dom(this->_impl)->getOwnerDocument(), false)));
 }
 
 Element::List Element::child(void) const
 {
     List result;
-    xercesc::DOMElement* next = this->_impl->ptr()->getFirstElementChild();
+    xercesc::DOMElement* next = dom(this->_impl)->getFirstElementChild();
     while ( next ) {
-        result.push_back(Element(Impl(new ElementImpl(next))));
+        result.push_back(Element(handle(next)));
         next = next->getNextElementSibling();
     }
     return result;
 }
+bool Element::hasChildren(void) const
+{
+    return dom(this->_impl)->getFirstElementChild() != nullptr;
+}
+std::size_t Element::childCount(void) const
+{
+    return dom(this->_impl)->getChildElementCount();
+}
 Element::List Element::getElementsByTagName(const std::wstring &name) const
 {
     List result;
-    xercesc::DOMNodeList* list = this->_impl->ptr()->getElementsByTagName(X(convert(name).c_str()));
+    xercesc::DOMElement* self = dom(this->_impl);
+    TagIndex* index = tag_index(self->getOwnerDocument());
+    if ( index && name != L"*" ) {
+        //! the indexed elements of the tag that are below `self`, in document order
+        //! a name never interned is the tag of no element
+        const HtmlTag::Atom atom = HtmlTag::lookup(name);
+        TagIndex::const_iterator tagged = atom != HtmlTag::unknown ? index->find(atom) : index->end();
+        if ( tagged == index->end() ) {
+            return result;
+        }
+        std::vector<xercesc::DOMElement*> matches;
+        for ( xercesc::DOMElement* elem : tagged->second ) {
+            xercesc::DOMNode* it = elem->getParentNode();
+            while ( it && it != self ) {
+                it = it->getParentNode();
+            }
+            if ( it ) {
+                matches.push_back(elem);
+            }
+        }
+        auto before = [](xercesc::DOMElement* a, xercesc::DOMElement* b){
+            return ( a->compareDocumentPosition(b) & xercesc::DOMNode::DOCUMENT_POSITION_FOLLOWING ) != 0;
+        };
+        //! elements are mostly created in document order
+        if ( ! std::is_sorted(matches.begin(), matches.end(), before) ) {
+            std::sort(matches.begin(), matches.end(), before);
+        }
+        for ( xercesc::DOMElement* elem : matches ) {
+            result.push_back(Element(handle(elem)));
+        }
+        return result;
+    }
+    xercesc::DOMNodeList* list = dom(this->_impl)->getElementsByTagName(X(name));
     for ( XMLSize_t i = 0; i < list->getLength(); ++i ) {
-        result.push_back(Element(Impl(new ElementImpl(reinterpret_cast<xercesc::DOMElement*>(list->item(i))))));
+        result.push_back(Element(handle(reinterpret_cast<xercesc::DOMElement*>(list->item(i)))));
     }
     return result;
 }
 Element Element::getFirstElementChild(void) const
 {
-    return Element(Impl(new ElementImpl(this->_impl->ptr()->getFirstElementChild())));
+    return Element(handle(dom(this->_impl)->getFirstElementChild()));
 }
 Element Element::getLastElementChild(void) const
 {
-    return Element(Impl(new ElementImpl(this->_impl->ptr()->getLastElementChild())));
+    return Element(handle(dom(this->_impl)->getLastElementChild()));
 }
 Element Element::getNextElementSibling(void) const
 {
-    return Element(Impl(new ElementImpl(this->_impl->ptr()->getNextElementSibling())));
+    return Element(handle(dom(this->_impl)->getNextElementSibling()));
 }
 
 bool Element::isNull(void) const
 {
-    return this->_impl->ptr() == nullptr;
+    return dom(this->_impl) == nullptr;
 }
 std::wstring Element::getTagName(void) const
 {
-    return wconvert(this->_impl->ptr()->getTagName());
+    return wconvert(dom(this->_impl)->getTagName());
+}
+HtmlTag::Atom Element::getTag(void) const
+{
+    return tag_atom(dom(this->_impl));
 }
 
 void Element::setAttribute(const std::wstring &key, const std::wstring &val)
 {
-    this->_impl->ptr()->setAttribute(X(convert(key).c_str()), X(convert(val).c_str()));
+    xercesc::DOMElement* elem = dom(this->_impl);
+    elem->setAttribute(X(key), X(val));
+    attribute_cache(elem->getOwnerDocument())->erase(elem);
 }
 
 Element::Attributes Element::getAttributes(void) const
 {
     Attributes result;
-    xercesc::DOMNamedNodeMap* attrs = this->_impl->ptr()->getAttributes();
+    xercesc::DOMNamedNodeMap* attrs = dom(this->_impl)->getAttributes();
     for ( XMLSize_t i = 0; i < attrs->getLength(); ++i ) {
         xercesc::DOMNode* attr = attrs->item(i);
         result[wconvert(attr->getNodeName())] = wconvert(attr->getNodeValue());
     }
     return result;
 }
+std::size_t Element::attributeCount(void) const
+{
+    return dom(this->_impl)->getAttributes()->getLength();
+}
+Attribute Element::attribute(std::size_t index) const
+{
+    //! every document is created by an ElementTreeImpl, which sets the cache
+    xercesc::DOMElement* elem = dom(this->_impl);
+    AttributeCache* cache = attribute_cache(elem->getOwnerDocument());
+    AttributeCache::iterator it = cache->find(elem);
+    if ( it == cache->end() ) {
+        it = cache->insert(std::make_pair(elem, SortedAttributes())).first;
+        sort_attributes(elem, it->second);
+    }
+    const SortedAttributes::value_type& attr = it->second[index];
+    return Attribute{attr.first, attr.second};
+}
 
 std::wstring Element::getNamespaceURI(void) const
 {
-    return wconvert(this->_impl->ptr()->getNamespaceURI());
+    return wconvert(dom(this->_impl)->getNamespaceURI());
 }
 
 std::wstring Element::getTextContent(void) const
 {
-    return wconvert(this->_impl->ptr()->getTextContent());
+    return wconvert(dom(this->_impl)->getTextContent());
 }
 
 bool Element::hasText(void) const
 {
-    xercesc::DOMElement* elem = this->_impl->ptr();
+    xercesc::DOMElement* elem = dom(this->_impl);
     return elem->hasChildNodes() && elem->getFirstChild()->getNodeType() == xercesc::DOMNode::TEXT_NODE;
 }
 bool Element::hasTail(void) const
 {
-    xercesc::DOMElement* elem = this->_impl->ptr();
+    xercesc::DOMElement* elem = dom(this->_impl);
     return elem->getNextSibling() && elem->getNextSibling()->getNodeType() == xercesc::DOMNode::TEXT_NODE;
 }
 
 void Element::removeText(void)
 {
     if ( this->hasText() ) {
-        xercesc::DOMElement* elem = this->_impl->ptr();
+        xercesc::DOMElement* elem = dom(this->_impl);
         elem->removeChild(elem->getFirstChild());
     }
 }
 void Element::removeTail(void)
 {
     if ( this->hasTail() ) {
-        xercesc::DOMElement* elem = this->_impl->ptr();
+        xercesc::DOMElement* elem = dom(this->_impl);
         elem->getParentNode()->removeChild(elem->getNextSibling());
     }
 }
@@ -340,11 +498,11 @@ void Element::removeTail(void)
 void Element::setText(const std::wstring &text)
 {
     if ( this->hasText() ) {
-        this->_impl->ptr()->getFirstChild()->setNodeValue(X(convert(text).c_str()));
+        dom(this->_impl)->getFirstChild()->setNodeValue(X(text));
     } else {
-        xercesc::DOMElement* elem = this->_impl->ptr();
+        xercesc::DOMElement* elem = dom(this->_impl);
         xercesc::DOMDocument* doc = elem->getOwnerDocument();
-        xercesc::DOMText* node = doc->createTextNode(X(convert(text).c_str()));
+        xercesc::DOMText* node = doc->createTextNode(X(text));
         if ( elem->hasChildNodes() ) {
             elem->insertBefore(node, elem->getFirstChild());
         } else {
@@ -355,18 +513,25 @@ void Element::setText(const std::wstring &text)
 void Element::setTail(const std::wstring &tail)
 {
     if ( this->hasTail() ) {
-        this->_impl->ptr()->getNextSibling()->setNodeValue(X(convert(tail).c_str()));
+        dom(this->_impl)->getNextSibling()->setNodeValue(X(tail));
     } else {
-        xercesc::DOMElement* elem = this->_impl->ptr();
+        xercesc::DOMElement* elem = dom(this->_impl);
         xercesc::DOMDocument* doc = elem->getOwnerDocument();
-        xercesc::DOMText* node = doc->createTextNode(X(convert(tail).c_str()));
+        xercesc::DOMText* node = doc->createTextNode(X(tail));
         if ( elem->getNextSibling() ) {
             elem->getParentNode()->insertBefore(node, elem->getNextSibling());
         } else {
             if ( elem->getParentNode() ) {
                 elem->getParentNode()->appendChild(node);
             } else {
-                Element dummy(Impl(new ElementImpl(doc->createElement(X("dummy")))));
+                //! a tail needs a parent: reuse the document's spare one
+                //! once the element it held has been moved out of it
+                xercesc::DOMElement* spare = static_cast<xercesc::DOMElement*>(doc->getUserData(DUMMY_KEY));
+                if ( spare == nullptr || spare->hasChildNodes() ) {
+                    spare = create_element(doc, L"dummy");
+                    doc->setUserData(DUMMY_KEY, spare, nullptr);
+                }
+                Element dummy(handle(spare));
                 dummy.append(*this);
                 this->setTail(tail);
             }
@@ -377,27 +542,25 @@ void Element::setTail(const std::wstring &tail)
 std::wstring Element::text(void) const
 {
     if ( this->hasText() ) {
-        return wconvert(this->_impl->ptr()->getFirstChild()->getNodeValue());
+        return wconvert(dom(this->_impl)->getFirstChild()->getNodeValue());
     }
     return std::wstring();
 }
 std::wstring Element::tail(void) const
 {
     if ( this->hasTail() ) {
-        return wconvert(this->_impl->ptr()->getNextSibling()->getNodeValue());
+        return wconvert(dom(this->_impl)->getNextSibling()->getNodeValue());
     }
     return std::wstring();
 }
 
 void Element::append(Element &child)
 {
-    bool tail = child.hasTail();
-    //! @warning: node is text!!!
-    Impl node(new ElementImpl((xercesc::DOMElement*)child._impl->ptr()->getNextSibling()));
-    xercesc::DOMElement* elem = this->_impl->ptr();
-    child._impl->update(reinterpret_cast<xercesc::DOMElement*>(elem->appendChild(this->import(child._impl)->ptr())));
+    xercesc::DOMElement* elem = dom(this->_impl);
+    xercesc::DOMNode* tail = import_node(elem->getOwnerDocument(), child.hasTail() ? dom(child._impl)->getNextSibling() : nullptr);
+    elem->appendChild(dom(this->import(child)));
     if ( tail ) {
-        elem->appendChild(this->import(node)->ptr());
+        elem->appendChild(tail);
     }
 }
 void Element::insertBefore(Element &child, const Element &ref)
@@ -406,41 +569,61 @@ void Element::insertBefore(Element &child, const Element &ref)
         //throw ...
         return;
     }
-    bool tail = child.hasTail();
-    //! @warning: node is text!!!
-    Impl node(new ElementImpl((xercesc::DOMElement*)child._impl->ptr()->getNextSibling()));
-    xercesc::DOMElement* elem = this->_impl->ptr();
-    xercesc::DOMElement* refChild = ref._impl->ptr();
-    child._impl->update(reinterpret_cast<xercesc::DOMElement*>(elem->insertBefore(this->import(child._impl)->ptr(), refChild)));
+    xercesc::DOMElement* elem = dom(this->_impl);
+    xercesc::DOMElement* refChild = dom(ref._impl);
+    xercesc::DOMNode* tail = import_node(elem->getOwnerDocument(), child.hasTail() ? dom(child._impl)->getNextSibling() : nullptr);
+    elem->insertBefore(dom(this->import(child)), refChild);
     if ( tail ) {
-        elem->insertBefore(this->import(node)->ptr(), refChild);
+        elem->insertBefore(tail, refChild);
     }
 }
 void Element::remove(Element &child)
 {
-    xercesc::DOMElement* elem = this->_impl->ptr();
-    if ( elem->isSameNode(child._impl->ptr()->getParentNode()) ) {
+    xercesc::DOMElement* elem = dom(this->_impl);
+    if ( elem->isSameNode(dom(child._impl)->getParentNode()) ) {
         bool tail = child.hasTail();
-        xercesc::DOMNode* node = child._impl->ptr()->getNextSibling();
-        child._impl->update(reinterpret_cast<xercesc::DOMElement*>(elem->removeChild(child._impl->ptr())));
+        xercesc::DOMNode* node = dom(child._impl)->getNextSibling();
+        elem->removeChild(dom(child._impl));
         if ( tail ) {
             elem->removeChild(node);
         }
     }
 }
 
-Element::Impl Element::import(Impl &target, bool deep)
+ElementImpl* Element::import(Element &target, bool deep)
 {
-    xercesc::DOMNode* self = this->_impl->ptr();
-    if ( ! self->getOwnerDocument()->isSameNode(target->ptr()->getOwnerDocument()) ) {
-        target->update(reinterpret_cast<xercesc::DOMElement*>(self->getOwnerDocument()->importNode(target->ptr(), deep)));
+    xercesc::DOMDocument* doc = dom(this->_impl)->getOwnerDocument();
+    if ( ! doc->isSameNode(dom(target._impl)->getOwnerDocument()) ) {
+        target._impl = handle(static_cast<xercesc::DOMElement*>(doc->importNode(dom(target._impl), deep)));
+        index_elements(doc, dom(target._impl));
     }
-    return target;
+    return target._impl;
+}
+
+Element ElementBuilder::append(const std::wstring &tag)
+{
+    xercesc::DOMElement* parent = dom(this->parent._impl);
+    xercesc::DOMElement* elem = create_element(parent->getOwnerDocument(), tag);
+    ++created_elements;
+    parent->appendChild(elem);
+    return Element(handle(elem));
+}
+Element ElementBuilder::append(const std::wstring &tag, const std::wstring &text)
+{
+    xercesc::DOMElement* parent = dom(this->parent._impl);
+    xercesc::DOMDocument* doc = parent->getOwnerDocument();
+    xercesc::DOMElement* elem = create_element(doc, tag);
+    ++created_elements;
+    elem->appendChild(doc->createTextNode(X(text)));
+    parent->appendChild(elem);
+    return Element(handle(elem));
 }
 
 ElementTree::ElementTree(const std::wstring &root) :
     _impl(ElementTreeImpl::generate(root))
-{}
+{
+    ++created_elements;
+}
 
 ElementTree::ElementTree(const Impl &impl) :
     _impl(impl)
@@ -462,4 +645,15 @@ ElementTree& ElementTree::operator =(const ElementTree& rhs)
     return *this;
 }
 
+bool ElementTree::recycle(const std::wstring &root)
+{
+    if ( ! this->_impl || ! this->_impl->ptr() || ! this->_impl->owner() || ! this->_impl.unique() ) {
+        return false;
+    }
+    this->_impl->recycle(root);
+    return true;
+}
+
 } // end of namespace markdown
+
+#endif // USE_ARENA_TREE
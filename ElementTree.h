@@ -8,18 +8,39 @@
 #ifndef ELEMENTTREE_H_
 #define ELEMENTTREE_H_
 
+#include <cstddef>
+#include <iterator>
 #include <list>
 #include <map>
 #include <string>
+#include <type_traits>
 
 #include <boost/shared_ptr.hpp>
+#include <boost/utility/string_view.hpp>
+
+#include "HtmlTag.h"
 
 namespace markdown{
 
-class ElementImpl;      //!< Pimpl
+class ElementImpl;      //!< node of the backend, only ever used by pointer
 class ElementTreeImpl;  //!< PImpl
 
-class Element;  //!< forward declaration for ElementTree
+class Element;          //!< forward declaration for ElementTree
+class ElementChildren;  //!< forward declaration for Element
+class AttributeRange;   //!< forward declaration for Element
+
+/*!
+ * An attribute as read through Element::attribute().
+ *
+ * The views point into storage of the element's document, valid until an
+ * attribute of the element is set again and at most as long as the
+ * document.
+ */
+struct Attribute
+{
+    boost::wstring_view name;
+    boost::wstring_view value;
+};
 
 class ElementTree
 {
@@ -35,6 +56,16 @@ public:
     ElementTree(ElementTree &&move);
     ElementTree& operator =(const ElementTree& rhs);
 
+    /*!
+     * Empty the document and give it a new `root` element, keeping its
+     * storage for the new nodes. Handles to the old elements are left
+     * dangling.
+     *
+     * Returns false, and does nothing, when another ElementTree shares
+     * the document or it is invalid.
+     */
+    bool recycle(const std::wstring& root);
+
 public:
     static ElementTree InvalidElementTree;
 
@@ -43,15 +74,22 @@ private:
 
 };
 
+/*!
+ * Handle to an element of an ElementTree.
+ *
+ * An Element is a single pointer: copying one allocates nothing, and the
+ * handles returned by the navigation calls are as cheap as the pointers
+ * they wrap. A handle does not keep its document alive.
+ */
 class Element
 {
+    friend class ElementChildren;
+    friend class ElementBuilder;
+
 public:
     typedef std::list<Element> List;
     typedef std::map<std::wstring, std::wstring> Attributes;
 
-private:
-    typedef boost::shared_ptr<ElementImpl> Impl;
-
 public:
     Element(const ElementTree &doc);
     Element(const ElementTree &doc, const std::wstring &name);
@@ -69,10 +107,6 @@ public:
      * @endcode
      */
     Element(const Element &parent, const std::wstring &name);
-    Element(const Element &copy);
-    Element(Element &&move);
-
-    Element& operator =(const Element &rhs);
 
     bool operator ==(const Element &rhs) const;
     bool operator !=(const Element &rhs) const;
@@ -80,6 +114,29 @@ public:
     ElementTree getOwnerDocument(void) const;
 
     List child(void) const;
+    /*!
+     * Range over the child elements that allocates nothing.
+     *
+     * It follows the sibling links, so unlike the list returned by
+     * child() it sees children inserted or removed while iterating.
+     */
+    ElementChildren children(void) const;
+    /*!
+     * Whether there is any child element. O(1).
+     */
+    bool hasChildren(void) const;
+    /*!
+     * Number of child elements. O(1) with the arena backend; the DOM
+     * backend counts them.
+     */
+    std::size_t childCount(void) const;
+    /*!
+     * Descendants named `name` (all of them for "*") in document order.
+     *
+     * The document indexes its elements by tag as they are created, so
+     * the cost depends on the number of elements with that tag, not on
+     * the size of the document.
+     */
     List getElementsByTagName(const std::wstring &name) const;
     Element getFirstElementChild(void) const;
     Element getLastElementChild(void) const;
@@ -87,9 +144,24 @@ public:
 
     bool isNull(void) const;
     std::wstring getTagName(void) const;
+    /*!
+     * Interned tag name, for comparisons and HtmlTag property checks
+     * without building the name.
+     */
+    HtmlTag::Atom getTag(void) const;
 
     void setAttribute(const std::wstring &key, const std::wstring &val);
     Attributes getAttributes(void) const;
+    /*!
+     * Number of attributes, and the `index`th of them in lexical order of
+     * the names. Neither allocates with the arena backend.
+     */
+    std::size_t attributeCount(void) const;
+    Attribute attribute(std::size_t index) const;
+    /*!
+     * Range over attribute(0) ... attribute(attributeCount()-1).
+     */
+    AttributeRange attributes(void) const;
 
     std::wstring getNamespaceURI(void) const;
     std::wstring getTextContent(void) const;
@@ -106,6 +178,10 @@ public:
     std::wstring text(void) const;
     std::wstring tail(void) const;
 
+    /*!
+     * An element of another document is copied into this one, and
+     * `child` is updated to refer to the copy.
+     */
     void append(Element &child);
     void insertBefore(Element &child, const Element &ref);
     void remove(Element &child);
@@ -113,13 +189,199 @@ public:
 public:
     static Element InvalidElement;
 
+    /*!
+     * Number of elements created on the calling thread so far.
+     */
+    static std::size_t createdCount(void);
+
 private:
-    Element(const Impl &elem);
-    Impl import(Impl &target, bool deep=true);
+    explicit Element(ElementImpl* elem);
+    ElementImpl* import(Element &target, bool deep=true);
     void initialize(void);
 
 private:
-    Impl _impl;
+    ElementImpl* _impl;
+
+};
+
+static_assert(std::is_trivially_copyable<Element>::value, "Element is a plain handle");
+
+/*!
+ * Forward range returned by Element::children().
+ */
+class ElementChildren
+{
+public:
+    class iterator
+    {
+    public:
+        typedef std::forward_iterator_tag iterator_category;
+        typedef Element                   value_type;
+        typedef std::ptrdiff_t            difference_type;
+        typedef const Element*            pointer;
+        typedef Element                   reference;
+
+    public:
+        explicit iterator(const Element& elem) :
+            elem(elem)
+        {}
+
+        Element operator *(void) const
+        { return this->elem; }
+        const Element* operator ->(void) const
+        { return &this->elem; }
+
+        iterator& operator ++(void)
+        {
+            this->elem = this->elem.getNextElementSibling();
+            return *this;
+        }
+        iterator operator ++(int)
+        {
+            iterator result = *this;
+            ++*this;
+            return result;
+        }
+
+        bool operator ==(const iterator& rhs) const
+        { return this->elem._impl == rhs.elem._impl; }
+        bool operator !=(const iterator& rhs) const
+        { return this->elem._impl != rhs.elem._impl; }
+
+    private:
+        Element elem;
+
+    };
+    typedef iterator const_iterator;
+
+public:
+    explicit ElementChildren(const Element& first) :
+        first(first)
+    {}
+
+    iterator begin(void) const
+    { return iterator(this->first); }
+    iterator end(void) const
+    { return iterator(Element(nullptr)); }
+
+private:
+    Element first;
+
+};
+
+inline ElementChildren Element::children(void) const
+{
+    return ElementChildren(this->getFirstElementChild());
+}
+
+/*!
+ * Forward range returned by Element::attributes().
+ */
+class AttributeRange
+{
+public:
+    class iterator
+    {
+    public:
+        typedef std::forward_iterator_tag iterator_category;
+        typedef Attribute                 value_type;
+        typedef std::ptrdiff_t            difference_type;
+        typedef const Attribute*          pointer;
+        typedef Attribute                 reference;
+
+    public:
+        iterator(const Element& elem, std::size_t index) :
+            elem(elem), index(index)
+        {}
+
+        Attribute operator *(void) const
+        { return this->elem.attribute(this->index); }
+
+        iterator& operator ++(void)
+        {
+            ++this->index;
+            return *this;
+        }
+        iterator operator ++(int)
+        {
+            iterator result = *this;
+            ++*this;
+            return result;
+        }
+
+        bool operator ==(const iterator& rhs) const
+        { return this->index == rhs.index; }
+        bool operator !=(const iterator& rhs) const
+        { return this->index != rhs.index; }
+
+    private:
+        Element     elem;
+        std::size_t index;
+
+    };
+    typedef iterator const_iterator;
+
+public:
+    explicit AttributeRange(const Element& elem) :
+        elem(elem), count(elem.attributeCount())
+    {}
+
+    iterator begin(void) const
+    { return iterator(this->elem, 0); }
+    iterator end(void) const
+    { return iterator(this->elem, this->count); }
+
+    std::size_t size(void) const
+    { return this->count; }
+    bool empty(void) const
+    { return this->count == 0; }
+
+private:
+    Element     elem;
+    std::size_t count;
+
+};
+
+inline AttributeRange Element::attributes(void) const
+{
+    return AttributeRange(*this);
+}
+
+/*!
+ * Builds a subtree below a parent element, in document order.
+ *
+ * The elements are created in the parent's document and linked as its
+ * last child at once, skipping what Element::append() does for an
+ * arbitrary child: comparing documents, importing, and carrying a tail
+ * along. A builder is a single handle; make one for each element that
+ * gets children.
+ *
+ * @code:
+ * ElementBuilder row(ElementBuilder(tbody).append(L"tr"));
+ * row.append(L"td", L"cell");
+ * @endcode
+ */
+class ElementBuilder
+{
+public:
+    explicit ElementBuilder(const Element& parent) :
+        parent(parent)
+    {}
+
+    /*!
+     * New last child `tag` of the parent.
+     */
+    Element append(const std::wstring& tag);
+    /*!
+     * New last child `tag` of the parent, with `text` (possibly empty).
+     */
+    Element append(const std::wstring& tag, const std::wstring& text);
+
+    const Element& element(void) const
+    { return this->parent; }
+
+private:
+    Element parent;
 
 };
 
@@ -0,0 +1,692 @@
+/*
+ * ElementTreeArena.cpp
+ *
+ *  Created on: 2026/10/17
+ *      Author: mugwort_rc
+ */
+
+/*!
+ * Native backend of Element and ElementTree.
+ *
+ * Built instead of the Xerces-C DOM backend in ElementTree.cpp when
+ * USE_ARENA_TREE is defined. Every node, string and attribute of a
+ * document is bump-allocated from an arena owned by the document; text
+ * and tail are fields of the element rather than separate text nodes,
+ * and strings stay wchar_t. The whole document is released at once with
+ * its last ElementTree.
+ *
+ * The behaviour follows the DOM backend: appending an element of another
+ * document copies it (with its tail) into this one and the handle is
+ * updated to the copy, and remove() drops the tail of the removed element.
+ *
+ * Attributes are an array in the arena, sorted by name, so attribute()
+ * reads them in place and in order. Their names are only strings of the
+ * document: they come from the source and are not interned.
+ *
+ * The document indexes its elements by tag as they are created, and
+ * siblings carry increasing order keys, so getElementsByTagName() looks at
+ * the elements of that tag only and sorts them into document order. The
+ * index keeps removed elements too, so a query costs O(created * depth +
+ * m log m) for the m elements it returns.
+ */
+
+#include "ElementTree.h"
+
+#ifdef USE_ARENA_TREE
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <boost/enable_shared_from_this.hpp>
+
+namespace markdown{
+
+namespace {
+
+thread_local std::size_t created_elements = 0;
+
+//! spacing of the order keys of consecutive siblings
+const std::uint64_t ORDER_GAP = std::uint64_t(1) << 32;
+
+/*!
+ * Bump allocator. Nothing is freed before the arena itself, or reset(),
+ * which keeps the blocks for the next allocations.
+ */
+class Arena
+{
+public:
+    Arena(void) :
+        blocks(), used(0), current(nullptr), remaining(0), next_size(4096)
+    {}
+
+    void reset(void)
+    {
+        this->used = 0;
+        this->current = nullptr;
+        this->remaining = 0;
+    }
+
+    void* allocate(std::size_t size, std::size_t align)
+    {
+        std::size_t pad = (align - reinterpret_cast<std::uintptr_t>(this->current) % align) % align;
+        if ( pad + size > this->remaining ) {
+            this->grow(size + align);
+            pad = (align - reinterpret_cast<std::uintptr_t>(this->current) % align) % align;
+        }
+        char* result = this->current + pad;
+        this->current = result + size;
+        this->remaining -= pad + size;
+        return result;
+    }
+
+    template<typename T>
+    T* create(void)
+    {
+        static_assert(std::is_trivially_destructible<T>::value, "arena objects are never destroyed");
+        return new (this->allocate(sizeof(T), alignof(T))) T();
+    }
+
+private:
+    struct Block
+    {
+        std::unique_ptr<char[]> data;
+        std::size_t             size;
+    };
+
+    void grow(std::size_t minimum)
+    {
+        //! blocks kept by reset() come first
+        if ( this->used < this->blocks.size() && this->blocks[this->used].size >= minimum ) {
+            Block& block = this->blocks[this->used++];
+            this->current = block.data.get();
+            this->remaining = block.size;
+            return;
+        }
+        const std::size_t size = std::max(this->next_size, minimum);
+        Block block = {std::unique_ptr<char[]>(new char[size]), size};
+        this->current = block.data.get();
+        this->remaining = size;
+        this->blocks.insert(this->blocks.begin() + this->used++, std::move(block));
+        this->next_size = std::min<std::size_t>(this->next_size*2, 1024*1024);
+    }
+
+private:
+    std::vector<Block> blocks;
+    std::size_t used;       //!< blocks handed out since the last reset
+    char*       current;
+    std::size_t remaining;
+    std::size_t next_size;
+
+};
+
+} // end of anonymous namespace
+
+/*!
+ * A string in the arena.
+ */
+struct ArenaString
+{
+    const wchar_t* data;
+    std::size_t    size;
+
+    std::wstring str(void) const
+    { return std::wstring(this->data, this->size); }
+    bool operator ==(const std::wstring& rhs) const
+    { return this->size == rhs.size() && std::equal(this->data, this->data+this->size, rhs.begin()); }
+    bool operator <(const ArenaString& rhs) const
+    { return std::lexicographical_compare(this->data, this->data+this->size, rhs.data, rhs.data+rhs.size); }
+    bool operator <(const std::wstring& rhs) const
+    { return std::lexicographical_compare(this->data, this->data+this->size, rhs.begin(), rhs.end()); }
+};
+
+struct ArenaAttribute
+{
+    ArenaString name;
+    ArenaString value;
+};
+
+/*!
+ * An element. Handles point straight at it.
+ */
+class ElementImpl
+{
+public:
+    ArenaString     tag;
+    HtmlTag::Atom   tag_atom;
+    ArenaString     text;
+    ArenaString     tail;
+    bool            has_text;
+    bool            has_tail;
+    ArenaAttribute*  attributes;    //!< sorted by name
+    std::uint32_t    attribute_count;
+    std::uint32_t    attribute_capacity;
+    ElementImpl*     parent;
+    ElementImpl*     first_child;
+    ElementImpl*     last_child;
+    ElementImpl*     prev;
+    ElementImpl*     next;
+    std::uint64_t    order;         //!< increasing along the siblings
+    std::size_t      child_count;
+    ElementTreeImpl* document;
+};
+
+class ElementTreeImpl : public boost::enable_shared_from_this<ElementTreeImpl>
+{
+public:
+    ElementTreeImpl(void) :
+        arena(), root(nullptr)
+    {}
+
+    ElementImpl* create(const std::wstring& tag)
+    {
+        return this->create(this->store(tag), HtmlTag::intern(tag));
+    }
+    ElementImpl* create(const ArenaString& tag, HtmlTag::Atom atom)
+    {
+        ElementImpl* node = this->arena.create<ElementImpl>();
+        node->tag = tag;
+        node->tag_atom = atom;
+        node->document = this;
+        this->tag_index[atom].push_back(node);
+        ++created_elements;
+        return node;
+    }
+    /*!
+     * Every element created with the tag `atom`, attached or not.
+     */
+    const std::vector<ElementImpl*>* tagged(HtmlTag::Atom atom) const
+    {
+        TagIndex::const_iterator it = this->tag_index.find(atom);
+        return it != this->tag_index.end() ? &it->second : nullptr;
+    }
+    ArenaString store(const std::wstring& text)
+    {
+        ArenaString result = {nullptr, text.size()};
+        if ( ! text.empty() ) {
+            wchar_t* data = static_cast<wchar_t*>(this->arena.allocate(text.size()*sizeof(wchar_t), alignof(wchar_t)));
+            std::memcpy(data, text.data(), text.size()*sizeof(wchar_t));
+            result.data = data;
+        }
+        return result;
+    }
+    ArenaString store(const ArenaString& text)
+    {
+        return this->store(text.str());
+    }
+    void setAttribute(ElementImpl* node, const std::wstring& key, const std::wstring& value)
+    {
+        ArenaAttribute* begin = node->attributes;
+        ArenaAttribute* end = begin + node->attribute_count;
+        ArenaAttribute* found = std::lower_bound(begin, end, key, [](const ArenaAttribute& a, const std::wstring& name){
+            return a.name < name;
+        });
+        if ( found != end && found->name == key ) {
+            found->value = this->store(value);
+            return;
+        }
+        const std::size_t pos = found - begin;
+        ArenaAttribute attr = {this->store(key), this->store(value)};
+        if ( node->attribute_count == node->attribute_capacity ) {
+            //! the old array is left to the arena
+            const std::uint32_t capacity = node->attribute_capacity ? node->attribute_capacity*2 : 2;
+            ArenaAttribute* grown = static_cast<ArenaAttribute*>(
+                this->arena.allocate(capacity*sizeof(ArenaAttribute), alignof(ArenaAttribute)));
+            std::copy(begin, end, grown);
+            node->attributes = grown;
+            node->attribute_capacity = capacity;
+        }
+        ArenaAttribute* slot = node->attributes + pos;
+        std::copy_backward(slot, node->attributes + node->attribute_count, node->attributes + node->attribute_count + 1);
+        *slot = attr;
+        ++node->attribute_count;
+    }
+
+    /*!
+     * Copy `source` of another document into this one, tail included.
+     */
+    ElementImpl* clone(const ElementImpl* source, bool deep)
+    {
+        ElementImpl* node = this->create(this->store(source->tag), source->tag_atom);
+        if ( source->attribute_count ) {
+            //! already sorted; only the strings move
+            node->attributes = static_cast<ArenaAttribute*>(
+                this->arena.allocate(source->attribute_count*sizeof(ArenaAttribute), alignof(ArenaAttribute)));
+            node->attribute_count = node->attribute_capacity = source->attribute_count;
+            for ( std::uint32_t i = 0; i < source->attribute_count; ++i ) {
+                const ArenaAttribute& attr = source->attributes[i];
+                node->attributes[i] = ArenaAttribute{this->store(attr.name), this->store(attr.value)};
+            }
+        }
+        if ( source->has_text ) {
+            node->text = this->store(source->text);
+            node->has_text = true;
+        }
+        if ( source->has_tail ) {
+            node->tail = this->store(source->tail);
+            node->has_tail = true;
+        }
+        if ( deep ) {
+            for ( const ElementImpl* child = source->first_child; child; child = child->next ) {
+                link(node, this->clone(child, true), nullptr);
+            }
+        }
+        return node;
+    }
+
+    ElementImpl* ptr(void) const
+    {
+        return this->root;
+    }
+
+public:
+    static void unlink(ElementImpl* node)
+    {
+        ElementImpl* parent = node->parent;
+        if ( parent == nullptr ) {
+            return;
+        }
+        (node->prev ? node->prev->next : parent->first_child) = node->next;
+        (node->next ? node->next->prev : parent->last_child) = node->prev;
+        node->parent = node->prev = node->next = nullptr;
+        --parent->child_count;
+    }
+    static void link(ElementImpl* parent, ElementImpl* node, ElementImpl* before)
+    {
+        node->parent = parent;
+        node->next = before;
+        node->prev = before ? before->prev : parent->last_child;
+        (node->prev ? node->prev->next : parent->first_child) = node;
+        (before ? before->prev : parent->last_child) = node;
+        ++parent->child_count;
+        order(parent, node);
+    }
+    /*!
+     * Give `node` an order key between those of its siblings, spacing all
+     * of them out again when there is no room left.
+     */
+    static void order(ElementImpl* parent, ElementImpl* node)
+    {
+        const std::uint64_t lo = node->prev ? node->prev->order : 0;
+        if ( node->next == nullptr ) {
+            node->order = lo + ORDER_GAP;
+            return;
+        }
+        const std::uint64_t hi = node->next->order;
+        if ( hi - lo > 1 ) {
+            node->order = lo + (hi - lo) / 2;
+            return;
+        }
+        std::uint64_t key = 0;
+        for ( ElementImpl* it = parent->first_child; it; it = it->next ) {
+            key += ORDER_GAP;
+            it->order = key;
+        }
+    }
+
+    static boost::shared_ptr<ElementTreeImpl> generate(const std::wstring &root)
+    {
+        boost::shared_ptr<ElementTreeImpl> impl(new ElementTreeImpl());
+        impl->root = impl->create(root);
+        return impl;
+    }
+    void recycle(const std::wstring &root)
+    {
+        this->arena.reset();
+        for ( TagIndex::value_type& tagged : this->tag_index ) {
+            tagged.second.clear();
+        }
+        this->root = this->create(root);
+    }
+
+private:
+    ElementTreeImpl(const ElementTreeImpl&);
+    ElementTreeImpl& operator =(const ElementTreeImpl&);
+
+private:
+    typedef std::unordered_map<HtmlTag::Atom, std::vector<ElementImpl*> > TagIndex;
+
+private:
+    Arena        arena;
+    ElementImpl* root;
+    TagIndex     tag_index;
+
+};
+
+ElementTree ElementTree::InvalidElementTree((ElementTree::Impl()));
+Element Element::InvalidElement(nullptr);
+
+std::size_t Element::createdCount(void)
+{
+    return created_elements;
+}
+
+Element::Element(ElementImpl* elem) :
+    _impl(elem)
+{}
+Element::Element(const ElementTree& doc) :
+    _impl(doc._impl->ptr())
+{}
+Element::Element(const ElementTree& doc, const std::wstring &name) :
+    _impl(doc._impl->create(name))
+{}
+Element::Element(const Element &parent, const std::wstring &name) :
+    _impl(parent._impl->document->create(name))
+{}
+
+bool Element::operator ==(const Element& rhs) const
+{
+    return this->_impl == rhs._impl;
+}
+
+bool Element::operator !=(const Element& rhs) const
+{
+    return ! Element::operator ==(rhs);
+}
+
+ElementTree Element::getOwnerDocument(void) const
+{
+    return ElementTree(this->_impl->document->shared_from_this());
+}
+
+Element::List Element::child(void) const
+{
+    List result;
+    for ( ElementImpl* next = this->_impl->first_child; next; next = next->next ) {
+        result.push_back(Element(next));
+    }
+    return result;
+}
+bool Element::hasChildren(void) const
+{
+    return this->_impl->first_child != nullptr;
+}
+std::size_t Element::childCount(void) const
+{
+    return this->_impl->child_count;
+}
+Element::List Element::getElementsByTagName(const std::wstring &name) const
+{
+    //! descendants in document order
+    List result;
+    ElementImpl* self = this->_impl;
+    if ( name != L"*" ) {
+        //! a name never interned is the tag of no element
+        const HtmlTag::Atom atom = HtmlTag::lookup(name);
+        const std::vector<ElementImpl*>* tagged = atom != HtmlTag::unknown ? self->document->tagged(atom) : nullptr;
+        if ( tagged == nullptr ) {
+            return result;
+        }
+        //! The order keys of the ancestors below `self` of a descendant,
+        //! from the top, compare lexicographically in document order. They
+        //! are stored back to back in `keys`.
+        struct Match
+        {
+            ElementImpl* node;
+            std::size_t  begin;
+            std::size_t  end;
+        };
+        std::vector<Match> matches;
+        std::vector<std::uint64_t> keys;
+        for ( ElementImpl* node : *tagged ) {
+            const std::size_t begin = keys.size();
+            const ElementImpl* it = node;
+            for ( ; it && it != self; it = it->parent ) {
+                keys.push_back(it->order);
+            }
+            if ( it == self && node != self ) {
+                std::reverse(keys.begin() + begin, keys.end());
+                matches.push_back(Match{node, begin, keys.size()});
+            } else {
+                keys.resize(begin);
+            }
+        }
+        auto before = [&keys](const Match& a, const Match& b){
+            return std::lexicographical_compare(keys.begin() + a.begin, keys.begin() + a.end,
+                                                keys.begin() + b.begin, keys.begin() + b.end);
+        };
+        //! elements are mostly created in document order
+        if ( ! std::is_sorted(matches.begin(), matches.end(), before) ) {
+            std::sort(matches.begin(), matches.end(), before);
+        }
+        for ( const Match& match : matches ) {
+            result.push_back(Element(match.node));
+        }
+        return result;
+    }
+    ElementImpl* node = self->first_child;
+    while ( node ) {
+        if ( name == L"*" || node->tag == name ) {
+            result.push_back(Element(node));
+        }
+        if ( node->first_child ) {
+            node = node->first_child;
+            continue;
+        }
+        while ( node != self && node->next == nullptr ) {
+            node = node->parent;
+        }
+        node = ( node == self ) ? nullptr : node->next;
+    }
+    return result;
+}
+Element Element::getFirstElementChild(void) const
+{
+    return Element(this->_impl->first_child);
+}
+Element Element::getLastElementChild(void) const
+{
+    return Element(this->_impl->last_child);
+}
+Element Element::getNextElementSibling(void) const
+{
+    return Element(this->_impl->next);
+}
+
+bool Element::isNull(void) const
+{
+    return this->_impl == nullptr;
+}
+std::wstring Element::getTagName(void) const
+{
+    return this->_impl->tag.str();
+}
+HtmlTag::Atom Element::getTag(void) const
+{
+    return this->_impl->tag_atom;
+}
+
+void Element::setAttribute(const std::wstring &key, const std::wstring &val)
+{
+    ElementImpl* node = this->_impl;
+    node->document->setAttribute(node, key, val);
+}
+
+Element::Attributes Element::getAttributes(void) const
+{
+    Attributes result;
+    const ElementImpl* node = this->_impl;
+    for ( std::uint32_t i = 0; i < node->attribute_count; ++i ) {
+        result[node->attributes[i].name.str()] = node->attributes[i].value.str();
+    }
+    return result;
+}
+std::size_t Element::attributeCount(void) const
+{
+    return this->_impl->attribute_count;
+}
+Attribute Element::attribute(std::size_t index) const
+{
+    const ArenaAttribute& attr = this->_impl->attributes[index];
+    return Attribute{boost::wstring_view(attr.name.data, attr.name.size),
+                     boost::wstring_view(attr.value.data, attr.value.size)};
+}
+
+std::wstring Element::getNamespaceURI(void) const
+{
+    return std::wstring();  //!< elements are created without a namespace
+}
+
+namespace {
+
+void text_content(const ElementImpl* node, std::wstring& result)
+{
+    if ( node->has_text ) {
+        result.append(node->text.data, node->text.size);
+    }
+    for ( const ElementImpl* child = node->first_child; child; child = child->next ) {
+        text_content(child, result);
+        if ( child->has_tail ) {
+            result.append(child->tail.data, child->tail.size);
+        }
+    }
+}
+
+} // end of anonymous namespace
+
+std::wstring Element::getTextContent(void) const
+{
+    std::wstring result;
+    text_content(this->_impl, result);
+    return result;
+}
+
+bool Element::hasText(void) const
+{
+    return this->_impl->has_text;
+}
+bool Element::hasTail(void) const
+{
+    return this->_impl->has_tail;
+}
+
+void Element::removeText(void)
+{
+    this->_impl->has_text = false;
+}
+void Element::removeTail(void)
+{
+    this->_impl->has_tail = false;
+}
+
+void Element::setText(const std::wstring &text)
+{
+    ElementImpl* node = this->_impl;
+    node->text = node->document->store(text);
+    node->has_text = true;
+}
+void Element::setTail(const std::wstring &tail)
+{
+    ElementImpl* node = this->_impl;
+    node->tail = node->document->store(tail);
+    node->has_tail = true;
+}
+
+std::wstring Element::text(void) const
+{
+    ElementImpl* node = this->_impl;
+    return node->has_text ? node->text.str() : std::wstring();
+}
+std::wstring Element::tail(void) const
+{
+    ElementImpl* node = this->_impl;
+    return node->has_tail ? node->tail.str() : std::wstring();
+}
+
+void Element::append(Element &child)
+{
+    ElementImpl* node = this->import(child);
+    ElementTreeImpl::unlink(node);
+    ElementTreeImpl::link(this->_impl, node, nullptr);
+}
+void Element::insertBefore(Element &child, const Element &ref)
+{
+    if ( ref.isNull() ) {
+        //throw ...
+        return;
+    }
+    ElementImpl* node = this->import(child);
+    ElementImpl* refChild = ref._impl;
+    if ( node == refChild ) {
+        return;
+    }
+    ElementTreeImpl::unlink(node);
+    ElementTreeImpl::link(this->_impl, node, refChild);
+}
+void Element::remove(Element &child)
+{
+    ElementImpl* node = child._impl;
+    if ( node->parent == this->_impl ) {
+        ElementTreeImpl::unlink(node);
+        node->has_tail = false;
+    }
+}
+
+ElementImpl* Element::import(Element &target, bool deep)
+{
+    ElementTreeImpl* document = this->_impl->document;
+    if ( target._impl->document != document ) {
+        target._impl = document->clone(target._impl, deep);
+    }
+    return target._impl;
+}
+
+Element ElementBuilder::append(const std::wstring &tag)
+{
+    ElementImpl* parent = this->parent._impl;
+    ElementImpl* node = parent->document->create(tag);
+    ElementTreeImpl::link(parent, node, nullptr);
+    return Element(node);
+}
+Element ElementBuilder::append(const std::wstring &tag, const std::wstring &text)
+{
+    ElementImpl* parent = this->parent._impl;
+    ElementImpl* node = parent->document->create(tag);
+    node->text = parent->document->store(text);
+    node->has_text = true;
+    ElementTreeImpl::link(parent, node, nullptr);
+    return Element(node);
+}
+
+ElementTree::ElementTree(const std::wstring &root) :
+    _impl(ElementTreeImpl::generate(root))
+{}
+
+ElementTree::ElementTree(const Impl &impl) :
+    _impl(impl)
+{}
+
+ElementTree::ElementTree(const ElementTree &copy) :
+    _impl(copy._impl)
+{}
+
+ElementTree::ElementTree(ElementTree &&move) :
+    _impl(move._impl)
+{
+    move._impl.reset();
+}
+
+ElementTree& ElementTree::operator =(const ElementTree& rhs)
+{
+    this->_impl = rhs._impl;
+    return *this;
+}
+
+bool ElementTree::recycle(const std::wstring &root)
+{
+    if ( ! this->_impl || ! this->_impl.unique() ) {
+        return false;
+    }
+    this->_impl->recycle(root);
+    return true;
+}
+
+} // end of namespace markdown
+
+#endif // USE_ARENA_TREE
@@ -0,0 +1,146 @@
+/*
+ * HtmlTag.cpp
+ *
+ *  Created on: 2026/10/17
+ *      Author: mugwort_rc
+ */
+
+#include "HtmlTag.h"
+
+#include <cwctype>
+#include <deque>
+#include <mutex>
+#include <unordered_map>
+#include <utility>
+
+namespace markdown{
+
+constexpr std::uint8_t HtmlTag::PROPERTIES[];
+
+namespace {
+
+const wchar_t* const KNOWN_NAMES[] = {
+    L"",
+#define MARKDOWN_HTML_TAG_NAME(name, properties) L ## #name,
+    MARKDOWN_HTML_TAGS(MARKDOWN_HTML_TAG_NAME)
+#undef MARKDOWN_HTML_TAG_NAME
+};
+
+static_assert(sizeof(KNOWN_NAMES)/sizeof(KNOWN_NAMES[0]) == HtmlTag::known_count, "one name per known tag");
+
+typedef std::unordered_map<std::wstring, HtmlTag::Atom> AtomMap;
+
+//! Built on first use and never modified afterwards.
+const AtomMap& known_atoms(void)
+{
+    static const AtomMap atoms = [](){
+        AtomMap result;
+        for ( HtmlTag::Atom atom = 1; atom < HtmlTag::known_count; ++atom ) {
+            result.insert(std::make_pair(std::wstring(KNOWN_NAMES[atom]), atom));
+        }
+        return result;
+    }();
+    return atoms;
+}
+
+struct InternedStore
+{
+    typedef std::pair<std::wstring, std::uint8_t> Entry;  //!< name, properties
+
+    std::mutex mutex;
+    AtomMap atoms;
+    std::deque<Entry> entries;  //!< indexed by atom - known_count
+};
+
+InternedStore& interned_store(void)
+{
+    static InternedStore store;
+    return store;
+}
+
+HtmlTag::Atom find_known(const std::wstring& name)
+{
+    const AtomMap& atoms = known_atoms();
+    AtomMap::const_iterator it = atoms.find(name);
+    return it != atoms.end() ? it->second : static_cast<HtmlTag::Atom>(HtmlTag::unknown);
+}
+
+//! known tags are lower case; other spellings share their properties
+std::uint8_t properties_ignoring_case(const std::wstring& name)
+{
+    std::wstring lower(name);
+    for ( wchar_t& ch : lower ) {
+        ch = std::towlower(ch);
+    }
+    return HtmlTag::properties(find_known(lower));
+}
+
+} // end of anonymous namespace
+
+HtmlTag::Atom HtmlTag::intern(const wchar_t* name, std::size_t size)
+{
+    std::wstring key(name, size);
+    Atom atom = find_known(key);
+    if ( atom != unknown ) {
+        return atom;
+    }
+    //! atoms never change, so each thread remembers the ones it has seen
+    //! and only takes the lock for new names
+    thread_local AtomMap seen;
+    AtomMap::const_iterator cached = seen.find(key);
+    if ( cached != seen.end() ) {
+        return cached->second;
+    }
+    InternedStore& store = interned_store();
+    std::lock_guard<std::mutex> lock(store.mutex);
+    AtomMap::const_iterator it = store.atoms.find(key);
+    if ( it != store.atoms.end() ) {
+        atom = it->second;
+    } else {
+        atom = known_count + static_cast<Atom>(store.entries.size());
+        store.entries.push_back(InternedStore::Entry(key, properties_ignoring_case(key)));
+        store.atoms.insert(std::make_pair(key, atom));
+    }
+    seen.insert(std::make_pair(key, atom));
+    return atom;
+}
+
+HtmlTag::Atom HtmlTag::lookup(const std::wstring& name)
+{
+    Atom atom = find_known(name);
+    if ( atom != unknown ) {
+        return atom;
+    }
+    InternedStore& store = interned_store();
+    std::lock_guard<std::mutex> lock(store.mutex);
+    AtomMap::const_iterator it = store.atoms.find(name);
+    return it != store.atoms.end() ? it->second : static_cast<Atom>(unknown);
+}
+
+std::uint8_t HtmlTag::properties(const std::wstring& name)
+{
+    Atom atom = find_known(name);
+    if ( atom != unknown ) {
+        return PROPERTIES[atom];
+    }
+    return properties_ignoring_case(name);
+}
+
+std::wstring HtmlTag::name(Atom atom)
+{
+    if ( atom < known_count ) {
+        return KNOWN_NAMES[atom];
+    }
+    InternedStore& store = interned_store();
+    std::lock_guard<std::mutex> lock(store.mutex);
+    return atom - known_count < store.entries.size() ? store.entries[atom - known_count].first : std::wstring();
+}
+
+std::uint8_t HtmlTag::internedProperties(Atom atom)
+{
+    InternedStore& store = interned_store();
+    std::lock_guard<std::mutex> lock(store.mutex);
+    return atom - known_count < store.entries.size() ? store.entries[atom - known_count].second : 0;
+}
+
+} // end of namespace markdown
@@ -0,0 +1,223 @@
+/*
+ * HtmlTag.h
+ *
+ *  Created on: 2026/10/17
+ *      Author: mugwort_rc
+ */
+
+#ifndef HTMLTAG_H_
+#define HTMLTAG_H_
+
+#include <cstdint>
+#include <string>
+
+namespace markdown{
+
+/*!
+ * Known HTML tags and their properties: name, block-level, empty (void),
+ * raw text, preformatted.
+ *
+ * The list is the single source of the enumeration, the name table and
+ * the property table below. Block-level tags are the ones matched by
+ * util::BLOCK_LEVEL_ELEMENTS, empty tags the ones the serializer writes
+ * without an end tag.
+ */
+#define MARKDOWN_HTML_TAGS(TAG) \
+    TAG(a,          0) \
+    TAG(abbr,       0) \
+    TAG(acronym,    0) \
+    TAG(address,    0) \
+    TAG(area,       HtmlTag::empty) \
+    TAG(article,    HtmlTag::block_level) \
+    TAG(aside,      HtmlTag::block_level) \
+    TAG(audio,      0) \
+    TAG(b,          0) \
+    TAG(base,       HtmlTag::empty) \
+    TAG(basefont,   HtmlTag::empty) \
+    TAG(bdo,        0) \
+    TAG(big,        0) \
+    TAG(blockquote, HtmlTag::block_level) \
+    TAG(body,       0) \
+    TAG(br,         HtmlTag::empty) \
+    TAG(button,     0) \
+    TAG(canvas,     HtmlTag::block_level) \
+    TAG(caption,    0) \
+    TAG(center,     0) \
+    TAG(cite,       0) \
+    TAG(code,       0) \
+    TAG(col,        HtmlTag::empty) \
+    TAG(colgroup,   0) \
+    TAG(dd,         HtmlTag::block_level) \
+    TAG(del,        0) \
+    TAG(details,    0) \
+    TAG(dfn,        0) \
+    TAG(div,        HtmlTag::block_level) \
+    TAG(dl,         HtmlTag::block_level) \
+    TAG(dt,         HtmlTag::block_level) \
+    TAG(em,         0) \
+    TAG(embed,      0) \
+    TAG(fieldset,   HtmlTag::block_level) \
+    TAG(figcaption, HtmlTag::block_level) \
+    TAG(figure,     HtmlTag::block_level) \
+    TAG(footer,     HtmlTag::block_level) \
+    TAG(form,       HtmlTag::block_level) \
+    TAG(frame,      HtmlTag::empty) \
+    TAG(group,      HtmlTag::block_level) \
+    TAG(h1,         HtmlTag::block_level) \
+    TAG(h2,         HtmlTag::block_level) \
+    TAG(h3,         HtmlTag::block_level) \
+    TAG(h4,         HtmlTag::block_level) \
+    TAG(h5,         HtmlTag::block_level) \
+    TAG(h6,         HtmlTag::block_level) \
+    TAG(head,       0) \
+    TAG(header,     HtmlTag::block_level) \
+    TAG(hr,         HtmlTag::block_level | HtmlTag::empty) \
+    TAG(html,       0) \
+    TAG(i,          0) \
+    TAG(iframe,     HtmlTag::block_level) \
+    TAG(img,        HtmlTag::empty) \
+    TAG(input,      HtmlTag::empty) \
+    TAG(ins,        0) \
+    TAG(isindex,    HtmlTag::empty) \
+    TAG(kbd,        0) \
+    TAG(label,      0) \
+    TAG(li,         HtmlTag::block_level) \
+    TAG(link,       HtmlTag::empty) \
+    TAG(listing,    HtmlTag::preformatted) \
+    TAG(math,       HtmlTag::block_level) \
+    TAG(meta,       HtmlTag::empty) \
+    TAG(nav,        0) \
+    TAG(noscript,   HtmlTag::block_level) \
+    TAG(object,     0) \
+    TAG(ol,         HtmlTag::block_level) \
+    TAG(option,     0) \
+    TAG(output,     HtmlTag::block_level) \
+    TAG(p,          HtmlTag::block_level) \
+    TAG(param,      HtmlTag::empty) \
+    TAG(pre,        HtmlTag::block_level | HtmlTag::preformatted) \
+    TAG(progress,   HtmlTag::block_level) \
+    TAG(q,          0) \
+    TAG(s,          0) \
+    TAG(samp,       0) \
+    TAG(script,     HtmlTag::block_level | HtmlTag::raw_text) \
+    TAG(section,    HtmlTag::block_level) \
+    TAG(select,     0) \
+    TAG(small,      0) \
+    TAG(span,       0) \
+    TAG(strike,     0) \
+    TAG(strong,     0) \
+    TAG(style,      HtmlTag::block_level | HtmlTag::raw_text) \
+    TAG(sub,        0) \
+    TAG(summary,    0) \
+    TAG(sup,        0) \
+    TAG(table,      HtmlTag::block_level) \
+    TAG(tbody,      HtmlTag::block_level) \
+    TAG(td,         HtmlTag::block_level) \
+    TAG(textarea,   0) \
+    TAG(tfoot,      0) \
+    TAG(th,         HtmlTag::block_level) \
+    TAG(thead,      HtmlTag::block_level) \
+    TAG(title,      0) \
+    TAG(tr,         HtmlTag::block_level) \
+    TAG(tt,         0) \
+    TAG(u,          0) \
+    TAG(ul,         HtmlTag::block_level) \
+    TAG(var,        0) \
+    TAG(video,      HtmlTag::block_level) \
+    TAG(xmp,        HtmlTag::preformatted)
+
+/*!
+ * Interned tag names.
+ *
+ * An Atom below known_count is a tag of MARKDOWN_HTML_TAGS; any other
+ * name gets an atom from a process-wide table the first time it is
+ * interned, and keeps it for the life of the process. Equal names have
+ * equal atoms, so comparing tags is comparing integers.
+ *
+ * Only the tags of created elements are interned, names the processors
+ * and extensions choose. Names taken from the source, such as attribute
+ * names, are not: the table would grow with every document.
+ *
+ * Names are case-sensitive, properties are not: "DIV" has its own atom
+ * but is block-level like "div", as util::BLOCK_LEVEL_ELEMENTS matched
+ * ignoring case.
+ *
+ * The functions are thread-safe.
+ */
+class HtmlTag
+{
+public:
+    typedef std::uint32_t Atom;
+
+    enum Known : Atom
+    {
+        unknown = 0,
+#define MARKDOWN_HTML_TAG_ENUM(name, properties) name,
+        MARKDOWN_HTML_TAGS(MARKDOWN_HTML_TAG_ENUM)
+#undef MARKDOWN_HTML_TAG_ENUM
+        known_count
+    };
+
+    enum Property : std::uint8_t
+    {
+        block_level  = 1 << 0,
+        empty        = 1 << 1,  //!< no content and no end tag
+        raw_text     = 1 << 2,  //!< content is written unescaped
+        preformatted = 1 << 3   //!< whitespace is significant
+    };
+
+public:
+    /*!
+     * Atom of `name`, added to the table if needed.
+     */
+    static Atom intern(const wchar_t* name, std::size_t size);
+    static Atom intern(const std::wstring& name)
+    { return intern(name.data(), name.size()); }
+    /*!
+     * Atom of `name` if it is known or already interned, unknown
+     * otherwise. Never adds to the table, so names that come from a
+     * query can be looked up.
+     */
+    static Atom lookup(const std::wstring& name);
+
+    static std::wstring name(Atom atom);
+
+    static std::uint8_t properties(Atom atom)
+    { return atom < known_count ? PROPERTIES[atom] : internedProperties(atom); }
+    /*!
+     * Properties of any name, ignoring case. Never adds to the table, so
+     * arbitrary strings of the source can be classified.
+     */
+    static std::uint8_t properties(const std::wstring& name);
+
+    static bool isBlockLevel(Atom atom)
+    { return (properties(atom) & block_level) != 0; }
+    static bool isEmpty(Atom atom)
+    { return (properties(atom) & empty) != 0; }
+    static bool isRawText(Atom atom)
+    { return (properties(atom) & raw_text) != 0; }
+    static bool isPreformatted(Atom atom)
+    { return (properties(atom) & preformatted) != 0; }
+
+private:
+    static std::uint8_t internedProperties(Atom atom);
+
+private:
+    static constexpr std::uint8_t PROPERTIES[known_count] = {
+        0,
+#define MARKDOWN_HTML_TAG_PROPERTIES(name, properties) properties,
+        MARKDOWN_HTML_TAGS(MARKDOWN_HTML_TAG_PROPERTIES)
+#undef MARKDOWN_HTML_TAG_PROPERTIES
+    };
+
+private:
+	HtmlTag(void);
+	HtmlTag(const HtmlTag&);
+	~HtmlTag(void);
+	HtmlTag& operator=(const HtmlTag&);
+
+};
+
+} // end of namespace markdown
+
+#endif // HTMLTAG_H_
@@ -21,7 +21,9 @@
 #include <boost/algorithm/string.hpp>
 #include <boost/format.hpp>
 
+#include "LinkScanner.h"
 #include "MarkdownCpp.h"
+#include "Context.h"
 
 namespace markdown{
 
@@ -40,7 +42,7 @@ const std::wstring STRONG_RE = L"(\\*{2}|_{2})(.+?)\\2";               //!< **st
 const std::wstring STRONG_EM_RE = L"(\\*{3}|_{3})(.+?)\\2";            //!< ***strong***
 const std::wstring SMART_EMPHASIS_RE = L"(?<!\\w)(_)(?!_)(.+?)(?<!_)\\2(?!\\w)";  //!< _smart_emphasis_
 const std::wstring EMPHASIS_2_RE = L"(_)(.+?)\\2";                                //!< _emphasis_
-const std::wstring LINK_RE = NOIMG + BRK + L"\\(\\s*(<.*?>|((?:(?:\\(.*?\\))|[^\\(\\)]))*?)\\s*((['\"])(.*?)\\12\\s*)?\\)";
+const std::wstring LINK_RE = NOIMG + BRK + L"\\(\\s*(<.*?>|((?:(?:\\(.*?\\))|[^\\(\\)]))*?)\\s*((['\"])(.*?)\\g{12}\\s*)?\\)";
 //!< [text](url) or [text](<url>) or [text](url "title")
 
 const std::wstring IMAGE_LINK_RE = L"\\!" + BRK + L"\\s*\\((<.*?>|([^\\)]*))\\)";
@@ -79,33 +81,76 @@ std::wstring handleAttributes(const std::wstring &text, Element &parent)
 //! Set values of an element based on attribute definitions ({@id=123}).
 
 Pattern::Pattern(const std::wstring &pattern, Markdown *markdown_instance) :
-    pattern(pattern), compiled_re((boost::wformat(L"^(.*?)%s(.*?)$")%pattern).str(), boost::regex_constants::mod_s),
+    pattern(pattern), compiled_re(RegexCache::get((boost::wformat(L"^(.*?)%s(.*?)$")%pattern).str(), boost::regex_constants::mod_s)),
+    scan_re(RegexCache::get((boost::wformat(L"()%s()")%pattern).str(), boost::regex_constants::mod_s)),
     //! Api for Markdown to pass safe_mode into instance
-    safe_mode(false), markdown(markdown_instance)
+    safe_mode(false), markdown(markdown_instance),
+    _rescan(rescan_all)
 {}
 
-std::wstring Pattern::unescape(const std::wstring &text)
+void Pattern::setTriggers(const std::wstring &chars)
 {
-    TreeProcessor::StashNodes stash;
-    if ( this->markdown->treeprocessors.exists("inline") ) {
-        stash = this->markdown->treeprocessors["inline"]->stashed_nodes;
-    } else {
+    this->_triggers.reset();
+    for ( wchar_t ch : chars ) {
+        if ( static_cast<unsigned long>(ch) >= this->_triggers.size() ) {
+            //! the set only holds ASCII: search everywhere
+            this->_triggers.reset();
+            return;
+        }
+        this->_triggers.set(ch);
+    }
+}
+
+namespace {
+
+/*!
+ * Replace the inline placeholders of `text` by what `expand(item, result)`
+ * appends for their item of the stash; placeholders of unknown ids are
+ * removed. The stash is read in place, as the inline processor left it.
+ */
+template<typename Expand>
+std::wstring expand_placeholders(const std::wstring& text, Expand expand)
+{
+    const std::wstring& prefix = util::INLINE_PLACEHOLDER_PREFIX;
+    std::wstring::size_type pos = text.find(prefix);
+    if ( pos == std::wstring::npos ) {
         return text;
     }
-    auto get_stash = [&](const boost::wsmatch &m) -> std::wstring {
-        std::wstring id = m.str(1);
-        if ( stash.find(id) != stash.end() ) {
-            TreeProcessor::NodeItem value = stash[id];
-            boost::optional<std::wstring> str = value.get<0>();
-            boost::optional<Element> node = value.get<1>();
-            if ( str ) {
-                return *str;
+    const TreeProcessor::StashNodes& stash = Context::current().stashed_nodes;
+    std::wstring result;
+    result.reserve(text.size());
+    std::wstring::size_type copied = 0;
+    while ( pos != std::wstring::npos ) {
+        std::size_t id, end;
+        if ( util::parseInlinePlaceholder(text, pos, id, end) ) {
+            result.append(text, copied, pos-copied);
+            if ( id < stash.size() ) {
+                expand(stash[id], result);
             }
-            return (*node).getTextContent();
+            copied = end;
+            pos = text.find(prefix, end);
+        } else {
+            pos = text.find(prefix, pos+1);
         }
-        return std::wstring();
-    };
-    return boost::regex_replace(text, util::INLINE_PLACEHOLDER_RE, get_stash);
+    }
+    result.append(text, copied, std::wstring::npos);
+    return result;
+}
+
+} // end of anonymous namespace
+
+std::wstring Pattern::unescape(const std::wstring &text)
+{
+    //! only the inline processor stashes nodes, so without it there is
+    //! nothing to expand
+    return expand_placeholders(text, [](const TreeProcessor::NodeItem& value, std::wstring& result){
+        const boost::optional<std::wstring>& str = value.get<0>();
+        if ( str ) {
+            result += *str;
+        } else {
+            result += value.get<1>()->getTextContent();
+        }
+    });
 }
 
 /*!
@@ -285,7 +330,7 @@ public:
     boost::optional<std::wstring> handleMatch(const boost::wsmatch &m)
     {
         std::wstring rawHtml = this->unescape(m.str(2));
-        return this->markdown->htmlStash.store(rawHtml);
+        return Context::current().htmlStash.store(rawHtml);
     }
 
     std::wstring type(void) const
@@ -293,27 +338,16 @@ public:
 
     std::wstring unescape(const std::wstring &text)
     {
-        TreeProcessor::StashNodes stash;
-        if ( this->markdown->treeprocessors.exists("inline") ) {
-            stash = this->markdown->treeprocessors["inline"]->stashed_nodes;
-        } else {
-            return text;
-        }
-        auto get_stash = [&](const boost::wsmatch &m) -> std::wstring {
-            std::wstring id = m.str(1);
-            if ( stash.find(id) != stash.end() ) {
-                TreeProcessor::NodeItem value = stash[id];
-                boost::optional<std::wstring> str = value.get<0>();
-                boost::optional<Element> node = value.get<1>();
-                if ( str ) {
-                    return L"\\" + *str;
-                } else {
-                    return this->markdown->serializer(*node);
-                }
+        return expand_placeholders(text, [this](const TreeProcessor::NodeItem& value, std::wstring& result){
+            const boost::optional<std::wstring>& str = value.get<0>();
+            if ( str ) {
+                result += L'\\';
+                result += *str;
+            } else {
+                Element node = *value.get<1>();
+                this->markdown->serializer(node, result);
             }
-            return std::wstring();
-        };
-        return boost::regex_replace(text, util::INLINE_PLACEHOLDER_RE, get_stash);
+        });
     }
 
 };
@@ -325,7 +359,8 @@ class LinkPattern : public Pattern
 {
 public:
     LinkPattern(const std::wstring& pattern, Markdown* md) :
-        Pattern(pattern, md)
+        Pattern(pattern, md),
+        NETLOC_RE(RegexCache::get(L"[a-zA-Z][a-zA-Z0-9+\\-.]*://[^/]+/?(.*)"))
     {}
     virtual ~LinkPattern(void)
     {}
@@ -413,7 +448,7 @@ public:
         }
         boost::wsmatch m;
         bool ret = false;
-        if ( ! (ret = boost::regex_match(result, m, boost::wregex(L"[a-zA-Z][a-zA-Z0-9+\\-.]*://[^/]+/?(.*)"))) && locless_schemes.find(scheme) == locless_schemes.end() ) {
+        if ( ! (ret = boost::regex_match(result, m, this->NETLOC_RE)) && locless_schemes.find(scheme) == locless_schemes.end() ) {
             //! This should not happen. Treat as suspect.
             return std::wstring();
         }
@@ -434,6 +469,33 @@ public:
     virtual std::wstring type(void) const
     { return L"LinkPattern"; }
 
+    /*!
+     * Search with a LinkScanner of `kind`, which must find what the
+     * pattern given to the constructor finds.
+     */
+    void setScanner(LinkScanner::Kind kind)
+    { this->scanner = LinkScanner(kind); }
+
+    virtual bool search(std::wstring::const_iterator base,
+                        std::wstring::const_iterator first, std::wstring::const_iterator last,
+                        boost::wsmatch& match, boost::match_flag_type flags) const
+    {
+        if ( ! this->scanner ) {
+            return Pattern::search(base, first, last, match, flags);
+        }
+        std::wstring::const_iterator start, end;
+        if ( ! this->scanner->search(base, first, last, start, end) ) {
+            return false;
+        }
+        //! the groups, from the text of the match alone
+        return boost::regex_match(start, end, match, this->getScanRegExp(), start != base ? boost::match_prev_avail : boost::match_default);
+    }
+
+private:
+    //! Split off the path of an url with a network location.
+    boost::wregex NETLOC_RE;
+    boost::optional<LinkScanner> scanner;
+
 };
 
 /*!
@@ -487,7 +549,7 @@ class ReferencePattern : public LinkPattern
 public:
     ReferencePattern(const std::wstring& pattern, Markdown* md) :
         LinkPattern(pattern, md),
-        NEWLINE_CLEANUP_RE(L"(?m)[ ]?\\n")
+        NEWLINE_CLEANUP_RE(RegexCache::get(L"(?m)[ ]?\\n"))
     {}
     virtual ~ReferencePattern(void)
     {}
@@ -506,10 +568,11 @@ public:
 
         //! Clean up linebreaks in id
         id = boost::regex_replace(id, this->NEWLINE_CLEANUP_RE, L" ");
-        if ( this->markdown->references.find(id) == this->markdown->references.end() ) {
+        const Context::Reference& references = Context::current().references;
+        if ( references.find(id) == references.end() ) {
             return Element::InvalidElement;
         }
-        Markdown::ReferenceItem item = this->markdown->references.at(id);
+        Context::ReferenceItem item = references.at(id);
 
         std::wstring text = m.str(2);
         return this->makeTag(doc, item.first, item.second, text);
@@ -671,31 +734,51 @@ public:
 
 };
 
+namespace {
+
+//! A built-in pattern, resuming after a replacement as early as its syntax
+//! requires and only searched for in text containing one of `triggers`.
+boost::shared_ptr<Pattern> builtin(Pattern* pattern, Pattern::Rescan rescan, const wchar_t* triggers)
+{
+    pattern->setRescan(rescan);
+    pattern->setTriggers(triggers);
+    return boost::shared_ptr<Pattern>(pattern);
+}
+
+//! A built-in link pattern, searched for with a LinkScanner of `kind`.
+boost::shared_ptr<Pattern> builtin(LinkPattern* pattern, LinkScanner::Kind kind, const wchar_t* triggers)
+{
+    pattern->setScanner(kind);
+    return builtin(pattern, Pattern::rescan_brackets, triggers);
+}
+
+} // end of anonymous namespace
+
 OrderedDictPatterns build_inlinepatterns(Markdown* md_instance)
 {
     OrderedDictPatterns inlinePatterns;
-    inlinePatterns.append("backtick", boost::shared_ptr<Pattern>(new BacktickPattern(BACKTICK_RE)));
-    inlinePatterns.append("escape", boost::shared_ptr<Pattern>(new EscapePattern(ESCAPE_RE, md_instance)));
-    inlinePatterns.append("reference", boost::shared_ptr<Pattern>(new ReferencePattern(REFERENCE_RE, md_instance)));
-    inlinePatterns.append("link", boost::shared_ptr<Pattern>(new LinkPattern(LINK_RE, md_instance)));
-    inlinePatterns.append("image_link", boost::shared_ptr<Pattern>(new ImagePattern(IMAGE_LINK_RE, md_instance)));
-    inlinePatterns.append("image_reference", boost::shared_ptr<Pattern>(new ImageReferencePattern(IMAGE_REFERENCE_RE, md_instance)));
-    inlinePatterns.append("short_reference", boost::shared_ptr<Pattern>(new ReferencePattern(SHORT_REF_RE, md_instance)));
-    inlinePatterns.append("autolink", boost::shared_ptr<Pattern>(new AutolinkPattern(AUTOLINK_RE, md_instance)));
-    inlinePatterns.append("automail", boost::shared_ptr<Pattern>(new AutomailPattern(AUTOMAIL_RE, md_instance)));
-    inlinePatterns.append("linebreak", boost::shared_ptr<Pattern>(new SubstituteTagPattern(LINE_BREAK_RE, L"br")));
+    inlinePatterns.append("backtick", builtin(new BacktickPattern(BACKTICK_RE), Pattern::rescan_closing, L"`"));
+    inlinePatterns.append("escape", builtin(new EscapePattern(ESCAPE_RE, md_instance), Pattern::rescan_none, L"\\"));
+    inlinePatterns.append("reference", builtin(new ReferencePattern(REFERENCE_RE, md_instance), LinkScanner::reference, L"["));
+    inlinePatterns.append("link", builtin(new LinkPattern(LINK_RE, md_instance), LinkScanner::link, L"["));
+    inlinePatterns.append("image_link", builtin(new ImagePattern(IMAGE_LINK_RE, md_instance), LinkScanner::image_link, L"!"));
+    inlinePatterns.append("image_reference", builtin(new ImageReferencePattern(IMAGE_REFERENCE_RE, md_instance), LinkScanner::image_reference, L"!"));
+    inlinePatterns.append("short_reference", builtin(new ReferencePattern(SHORT_REF_RE, md_instance), LinkScanner::short_reference, L"["));
+    inlinePatterns.append("autolink", builtin(new AutolinkPattern(AUTOLINK_RE, md_instance), Pattern::rescan_none, L"<"));
+    inlinePatterns.append("automail", builtin(new AutomailPattern(AUTOMAIL_RE, md_instance), Pattern::rescan_none, L"<"));
+    inlinePatterns.append("linebreak", builtin(new SubstituteTagPattern(LINE_BREAK_RE, L"br"), Pattern::rescan_none, L"\n"));
     if ( md_instance->safeMode() != Markdown::escape_mode ) {
-        inlinePatterns.append("html", boost::shared_ptr<Pattern>(new HtmlPattern(HTML_RE, md_instance)));
+        inlinePatterns.append("html", builtin(new HtmlPattern(HTML_RE, md_instance), Pattern::rescan_none, L"<"));
     }
-    inlinePatterns.append("entity", boost::shared_ptr<Pattern>(new HtmlPattern(ENTITY_RE, md_instance)));
-    inlinePatterns.append("not_strong", boost::shared_ptr<Pattern>(new SimpleTextPattern(NOT_STRONG_RE)));
-    inlinePatterns.append("strong_em", boost::shared_ptr<Pattern>(new DoubleTagPattern(STRONG_EM_RE, L"strong,em")));
-    inlinePatterns.append("strong", boost::shared_ptr<Pattern>(new SimpleTagPattern(STRONG_RE, L"strong")));
-    inlinePatterns.append("emphasis", boost::shared_ptr<Pattern>(new SimpleTagPattern(EMPHASIS_RE, L"em")));
+    inlinePatterns.append("entity", builtin(new HtmlPattern(ENTITY_RE, md_instance), Pattern::rescan_none, L"&"));
+    inlinePatterns.append("not_strong", builtin(new SimpleTextPattern(NOT_STRONG_RE), Pattern::rescan_none, L"*_"));
+    inlinePatterns.append("strong_em", builtin(new DoubleTagPattern(STRONG_EM_RE, L"strong,em"), Pattern::rescan_none, L"*_"));
+    inlinePatterns.append("strong", builtin(new SimpleTagPattern(STRONG_RE, L"strong"), Pattern::rescan_none, L"*_"));
+    inlinePatterns.append("emphasis", builtin(new SimpleTagPattern(EMPHASIS_RE, L"em"), Pattern::rescan_adjacent, L"*"));
     if ( md_instance->smart_emphasis() ) {
-        inlinePatterns.append("emphasis2", boost::shared_ptr<Pattern>(new SimpleTagPattern(SMART_EMPHASIS_RE, L"em")));
+        inlinePatterns.append("emphasis2", builtin(new SimpleTagPattern(SMART_EMPHASIS_RE, L"em"), Pattern::rescan_none, L"_"));
     } else {
-        inlinePatterns.append("emphasis2", boost::shared_ptr<Pattern>(new SimpleTagPattern(EMPHASIS_2_RE, L"em")));
+        inlinePatterns.append("emphasis2", builtin(new SimpleTagPattern(EMPHASIS_2_RE, L"em"), Pattern::rescan_none, L"_"));
     }
     return inlinePatterns;
 }
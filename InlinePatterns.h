@@ -8,6 +8,8 @@
 #ifndef INLINEPATTERNS_H_
 #define INLINEPATTERNS_H_
 
+#include <bitset>
+
 #include <boost/optional.hpp>
 #include <boost/regex.hpp>
 
@@ -38,6 +40,13 @@ namespace markdown{
  * '^(.*)' and end with '(.*)!'.  In case with built-in expression
  * Pattern takes care of adding the "^(.*)" and "(.*)!".
  *
+ * The inline processor does not match these against the whole block:
+ * it scans the block once per pattern with search() for getScanRegExp(),
+ * the pattern with empty groups in place of "^(.*)" and "(.*)!", and
+ * resumes after each replacement as told by rescan().  Patterns that
+ * declare their triggers() are skipped for blocks that contain none of
+ * them.
+ *
  * Finally, the order in which regular expressions are applied is very
  * important - e.g. if we first replace http://.../ links with <a> tags
  * and _then_ try to replace inline html, we would end up with a mess.
@@ -86,6 +95,60 @@ public:
     boost::wregex getCompiledRegExp(void) const
     { return this->compiled_re; }
 
+    /*!
+     * Return the regular expression searched for by the inline
+     * processor: the pattern alone, its groups numbered as in
+     * getCompiledRegExp().
+     */
+    const boost::wregex& getScanRegExp(void) const
+    { return this->scan_re; }
+
+    /*!
+     * Search [first, last) for the first match of getScanRegExp(), as
+     * regex_search() does with `flags`; look-behinds see back to `base`.
+     *
+     * Patterns with a recognizer of their own override it.
+     */
+    virtual bool search(std::wstring::const_iterator base,
+                        std::wstring::const_iterator first, std::wstring::const_iterator last,
+                        boost::wsmatch& match, boost::match_flag_type flags) const
+    { return boost::regex_search(first, last, match, this->scan_re, flags, base); }
+
+    /*!
+     * Where the search for the next match resumes once a match has been
+     * replaced by its placeholder.
+     *
+     * A replacement can complete a match that starts earlier: in
+     * "**a* b*", the placeholder of "*a*" completes the emphasis of "*...b*".
+     * By default the whole text is searched again; the built-in patterns
+     * declare how far back such a match can start.
+     */
+    enum Rescan
+    {
+        rescan_all,       //!< from the start of the text
+        rescan_none,      //!< after the placeholder
+        rescan_adjacent,  //!< from the character before the placeholder when the match starts with it too
+        rescan_closing,   //!< from the first of that character in the text, which it may now close
+        rescan_brackets   //!< from the earliest '[' (or "![") left open before the placeholder
+    };
+
+    Rescan rescan(void) const
+    { return this->_rescan; }
+    void setRescan(Rescan rescan)
+    { this->_rescan = rescan; }
+
+    /*!
+     * ASCII characters at least one of which every match contains.
+     *
+     * The inline processor does not search text that has none of them.
+     * A pattern that declares none is searched for in all text.
+     */
+    typedef std::bitset<128> Triggers;
+
+    const Triggers& triggers(void) const
+    { return this->_triggers; }
+    void setTriggers(const std::wstring& chars);
+
     /*!
      * Return a ElementTree element from the given match.
      *
@@ -114,9 +177,13 @@ public:
 protected:
     std::wstring pattern;
     boost::wregex compiled_re;
+    boost::wregex scan_re;
     bool safe_mode;
     Markdown* markdown;
 
+private:
+    Rescan _rescan;
+    Triggers _triggers;
 
 };
 
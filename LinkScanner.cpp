@@ -0,0 +1,338 @@
+/*
+ * LinkScanner.cpp
+ *
+ *  Created on: 2026/10/17
+ *      Author: mugwort_rc
+ */
+
+#include "LinkScanner.h"
+
+#include <algorithm>
+#include <functional>
+#include <vector>
+
+#include <boost/regex.hpp>
+
+namespace markdown{
+
+namespace {
+
+typedef LinkScanner::Iterator Iterator;
+
+//! BRK: the brackets and six levels nested in them
+const std::size_t MAX_LEVELS = 7;
+
+//! `\s` of boost::wregex
+bool is_space(wchar_t ch)
+{
+    typedef boost::wregex::traits_type Traits;
+    static const Traits traits;
+    static const wchar_t name[] = L"s";
+    static const Traits::char_class_type space = traits.lookup_classname(name, name+1);
+    return traits.isctype(ch, space);
+}
+
+Iterator skip_spaces(Iterator it, Iterator last)
+{
+    while ( it != last && is_space(*it) ) {
+        ++it;
+    }
+    return it;
+}
+
+/*!
+ * First position at or after a given one that `accept` takes.
+ *
+ * The positions asked for during one search only move forward, so the
+ * last answer stands for every position up to it and the text between
+ * is never read twice.
+ */
+class Finder
+{
+public:
+    typedef std::function<bool(Iterator)> Accept;
+
+public:
+    Finder(Iterator last, const Accept& accept) :
+        from(last), found(last), last(last), accept(accept), valid(false)
+    {}
+
+    Iterator operator()(Iterator it)
+    {
+        if ( this->valid && this->from <= it && it <= this->found ) {
+            return this->found;
+        }
+        this->from = it;
+        while ( it != this->last && ! this->accept(it) ) {
+            ++it;
+        }
+        this->found = it;
+        this->valid = true;
+        return it;
+    }
+
+private:
+    Iterator from;
+    Iterator found;
+    Iterator last;
+    Accept accept;
+    bool valid;
+
+};
+
+/*!
+ * What follows the ']' of BRK in each pattern, read as the regular
+ * expression would: the first way through it in backtracking order.
+ */
+class Tail
+{
+public:
+    explicit Tail(Iterator last) :
+        last(last),
+        paren(last, [](Iterator it){ return *it == L')'; }),
+        bracket(last, [](Iterator it){ return *it == L']'; }),
+        double_quote(last, [this](Iterator it){ return *it == L'"' && this->isClose(it+1); }),
+        single_quote(last, [this](Iterator it){ return *it == L'\'' && this->isClose(it+1); }),
+        link_angle(last, [this](Iterator it){ Iterator end; return *it == L'>' && this->closes(it+1, end); }),
+        image_angle(last, [this](Iterator it){ return *it == L'>' && it+1 != this->last && *(it+1) == L')'; })
+    {}
+
+    //! \(\s*(<.*?>|((?:(?:\(.*?\))|[^\(\)]))*?)\s*((['"])(.*?)\g{12}\s*)?\)
+    bool link(Iterator it, Iterator& end)
+    {
+        if ( it == this->last || *it != L'(' ) {
+            return false;
+        }
+        it = skip_spaces(it+1, this->last);
+        if ( it != this->last && *it == L'<' ) {
+            Iterator close = this->link_angle(it+1);
+            if ( close != this->last ) {
+                return this->closes(close+1, end);
+            }
+        }
+        //! the shortest destination, a parenthesis taking everything up
+        //! to the next ')', that the title and ')' can follow
+        while ( ! this->closes(it, end) ) {
+            if ( it == this->last || *it == L')' ) {
+                return false;
+            }
+            if ( *it == L'(' ) {
+                it = this->paren(it+1);
+                if ( it == this->last ) {
+                    return false;
+                }
+            }
+            ++it;
+        }
+        return true;
+    }
+
+    //! \s*\((<.*?>|([^\)]*))\)
+    bool image(Iterator it, Iterator& end)
+    {
+        it = skip_spaces(it, this->last);
+        if ( it == this->last || *it != L'(' ) {
+            return false;
+        }
+        ++it;
+        if ( it != this->last && *it == L'<' ) {
+            Iterator close = this->image_angle(it+1);
+            if ( close != this->last ) {
+                end = close+2;
+                return true;
+            }
+        }
+        Iterator close = this->paren(it);
+        if ( close == this->last ) {
+            return false;
+        }
+        end = close+1;
+        return true;
+    }
+
+    //! \s?\[([^\]]*)\]
+    bool reference(Iterator it, Iterator& end)
+    {
+        if ( it != this->last && is_space(*it) ) {
+            ++it;
+        }
+        if ( it == this->last || *it != L'[' ) {
+            return false;
+        }
+        Iterator close = this->bracket(it+1);
+        if ( close == this->last ) {
+            return false;
+        }
+        end = close+1;
+        return true;
+    }
+
+    //! \[([^\]]+)\] from the '[' at `it`
+    bool shortReference(Iterator it, Iterator& end)
+    {
+        Iterator close = this->bracket(it+1);
+        if ( close == this->last || close == it+1 ) {
+            return false;
+        }
+        end = close+1;
+        return true;
+    }
+
+    //! no ']' closes a '[' at or after `it`
+    bool unclosed(Iterator it)
+    {
+        return this->bracket(it) == this->last;
+    }
+
+private:
+    //! \s*\)
+    bool isClose(Iterator it) const
+    {
+        it = skip_spaces(it, this->last);
+        return it != this->last && *it == L')';
+    }
+
+    //! \s*((['"])(.*?)\g{12}\s*)?\) of LINK_RE: a title closed by
+    //! the quote that opened it
+    bool closes(Iterator it, Iterator& end)
+    {
+        it = skip_spaces(it, this->last);
+        if ( it == this->last ) {
+            return false;
+        }
+        if ( *it == L'"' || *it == L'\'' ) {
+            Iterator quote = *it == L'"' ? this->double_quote(it+1) : this->single_quote(it+1);
+            if ( quote == this->last ) {
+                return false;
+            }
+            end = skip_spaces(quote+1, this->last) + 1;
+            return true;
+        }
+        if ( *it == L')' ) {
+            end = it+1;
+            return true;
+        }
+        return false;
+    }
+
+private:
+    Iterator last;
+    Finder paren;
+    Finder bracket;
+    Finder double_quote;
+    Finder single_quote;
+    Finder link_angle;
+    Finder image_angle;
+
+};
+
+//! the character before `it` is a '!' that the search may look at
+bool after_bang(Iterator base, Iterator it)
+{
+    return it > base && *(it-1) == L'!';
+}
+
+} // end of anonymous namespace
+
+bool LinkScanner::search(Iterator base, Iterator first, Iterator last, Iterator& start, Iterator& end) const
+{
+    Tail tail(last);
+    if ( this->_kind == short_reference ) {
+        for ( Iterator it = std::find(first, last, L'['); it != last; it = std::find(it+1, last, L'[') ) {
+            if ( tail.unclosed(it+1) ) {
+                return false;
+            }
+            if ( ! after_bang(base, it) && tail.shortReference(it, end) ) {
+                start = it;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    //! a '[' is dead once it can no longer start BRK: a text between
+    //! two of its nested brackets, or too many levels in it. Its
+    //! enclosing '[' are then dead too, so the dead ones are the first
+    //! `dead` of the stack.
+    enum State
+    {
+        before_nested,  //!< only text so far
+        after_nested,   //!< right after a nested ']'
+        text_after      //!< text after a nested ']'
+    };
+    struct Open
+    {
+        Iterator pos;
+        State state;
+    };
+    std::vector<Open> stack;
+    std::size_t dead = 0;
+    bool found = false;
+    std::size_t enclosing = 0;  //!< the first of the stack, which start before the match found
+    for ( Iterator it = first; it != last; ++it ) {
+        if ( *it == L'[' ) {
+            if ( ! stack.empty() && stack.back().state == text_after ) {
+                dead = stack.size();
+            }
+            stack.push_back(Open{it, before_nested});
+            if ( stack.size() > MAX_LEVELS ) {
+                dead = std::max(dead, stack.size() - MAX_LEVELS);
+            }
+            if ( found && dead >= enclosing ) {
+                return true;
+            }
+        } else if ( *it == L']' ) {
+            if ( stack.empty() ) {
+                continue;
+            }
+            Open open = stack.back();
+            stack.pop_back();
+            const bool alive = stack.size() >= dead;
+            dead = std::min(dead, stack.size());
+            enclosing = std::min(enclosing, stack.size());
+            if ( ! stack.empty() ) {
+                stack.back().state = after_nested;
+            }
+            //! enclosing brackets start earlier, so they replace what
+            //! was found inside them
+            Iterator match_start, match_end;
+            bool matched = false;
+            if ( alive ) {
+                switch ( this->_kind ) {
+                case link:
+                    matched = ! after_bang(base, open.pos) && tail.link(it+1, match_end);
+                    match_start = open.pos;
+                    break;
+                case reference:
+                    matched = ! after_bang(base, open.pos) && tail.reference(it+1, match_end);
+                    match_start = open.pos;
+                    break;
+                case image_link:
+                    matched = open.pos != first && *(open.pos-1) == L'!' && tail.image(it+1, match_end);
+                    match_start = open.pos-1;
+                    break;
+                case image_reference:
+                    matched = open.pos != first && *(open.pos-1) == L'!' && tail.reference(it+1, match_end);
+                    match_start = open.pos-1;
+                    break;
+                default:
+                    break;
+                }
+            }
+            if ( matched && ( ! found || match_start < start ) ) {
+                start = match_start;
+                end = match_end;
+                found = true;
+                enclosing = stack.size();
+            }
+            if ( found && dead >= enclosing ) {
+                return true;
+            }
+        } else if ( ! stack.empty() && stack.back().state == after_nested ) {
+            stack.back().state = text_after;
+        }
+    }
+    return found;
+}
+
+} // end of namespace markdown
@@ -0,0 +1,69 @@
+/*
+ * LinkScanner.h
+ *
+ *  Created on: 2026/10/17
+ *      Author: mugwort_rc
+ */
+
+#ifndef LINKSCANNER_H_
+#define LINKSCANNER_H_
+
+#include <string>
+
+namespace markdown{
+
+/*!
+ * Recognizer of the bracketed inline patterns: links, images and
+ * references.
+ *
+ * It finds the match regex_search() finds with LINK_RE, IMAGE_LINK_RE,
+ * REFERENCE_RE, IMAGE_REFERENCE_RE or SHORT_REF_RE, without their
+ * backtracking. The brackets are read once, left to right, keeping the
+ * '[' still open on a stack: a '[' is the start of BRK if its ']' closes
+ * it, at most six levels of brackets are nested in it and, at every
+ * level, the nested brackets follow each other with text only before and
+ * after them. The destination, title or reference id after the ']' is
+ * then read up to the character that ends it.
+ */
+class LinkScanner
+{
+public:
+    typedef std::wstring::const_iterator Iterator;
+
+    enum Kind
+    {
+        link,             //!< [text](url "title")
+        image_link,       //!< ![alt](url)
+        reference,        //!< [text][id]
+        image_reference,  //!< ![alt][id]
+        short_reference   //!< [id]
+    };
+
+public:
+    explicit LinkScanner(Kind kind) :
+        _kind(kind)
+    {}
+
+    Kind kind(void) const
+    { return this->_kind; }
+
+    /*!
+     * Find the leftmost match in [first, last).
+     *
+     * A '[' may not follow a '!' for link, reference and short_reference;
+     * the character before `first` is only looked at if `base` is before
+     * `first`, as for regex_search().
+     *
+     * Returns false if there is none; otherwise stores where it starts
+     * and ends.
+     */
+    bool search(Iterator base, Iterator first, Iterator last, Iterator& start, Iterator& end) const;
+
+private:
+    Kind _kind;
+
+};
+
+} // end of namespace markdown
+
+#endif // LINKSCANNER_H_
@@ -7,22 +7,79 @@
 
 #include "MarkdownCpp.h"
 
+#include <algorithm>
+#include <atomic>
+#include <cwctype>
+#include <exception>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <mutex>
+#include <thread>
+
 #include <boost/algorithm/string.hpp>
 #include <boost/algorithm/string/regex.hpp>
 #include <boost/format.hpp>
+#include <boost/iostreams/device/mapped_file.hpp>
 #include <boost/regex.hpp>
 
 #include "PreProcessors.h"
+#include "Profiler.h"
 #include "BlockParser.h"
 #include "BlockProcessors.h"
 #include "Serializers.h"
+#include "Unicode.h"
 
 namespace markdown{
 
+namespace {
+
+//! Number of characters encoded per write by write_utf8().
+const std::size_t WRITE_CHUNK_SIZE = 16384;
+
+/*!
+ * Decode a UTF-8 source document, dropping a leading byte-order mark.
+ */
+void decode_source(boost::string_view bytes, std::wstring& text)
+{
+    if ( bytes.starts_with("\xEF\xBB\xBF") ) {
+        bytes.remove_prefix(3);
+    }
+    utf8_decode(bytes, text);
+}
+
+/*!
+ * Write `size` characters of `text` to `output` as UTF-8, encoding them
+ * in fixed size chunks so the encoded document is never held in memory
+ * as a whole.
+ */
+void write_utf8(std::ostream& output, const wchar_t* text, std::size_t size)
+{
+    std::string buffer;
+    std::size_t pos = 0;
+    while ( pos < size ) {
+        std::size_t count = std::min(WRITE_CHUNK_SIZE, size - pos);
+        //! do not split a surrogate pair between two chunks
+        wchar_t last = text[pos+count-1];
+        if ( sizeof(wchar_t) == 2 && pos + count < size && last >= 0xD800 && last <= 0xDBFF ) {
+            --count;
+        }
+        buffer.clear();
+        utf8_encode(text+pos, count, buffer);
+        output.write(buffer.data(), buffer.size());
+        pos += count;
+    }
+}
+
+} // end of anonymous namespace
+
 Markdown::Markdown(void) :
 	_doc_tag(L"div"),
     _html_replacement_text(L"[HTML_REMOVED]"), _tab_length(4), _enable_attributes(true), _smart_emphasis(true), _lazy_ol(true),
+    _output_format(xhtml1),
 	_safeMode(default_mode),
+    _budget(),
+    _registeredExtensions(),
     //todo
     stripTopLevelTags(true),
 
@@ -36,9 +93,6 @@ Markdown::Markdown(void) :
     treeprocessors(),
     postprocessors(),
 
-    references(),
-    htmlStash(),
-
     serializer()
 {
     this->build_parser();
@@ -67,85 +121,252 @@ Markdown& Markdown::registerExtensions(const Extensions &extensions/*, configs*/
 {
     for ( const Extension::Ptr& ext : extensions ) {
         ext->extendMarkdown(this);
+        this->registerExtension(ext);
     }
 	return *this;
 }
 
-Markdown& Markdown::registerExtension(const Extension::Ptr&)
+Markdown& Markdown::registerExtension(const Extension::Ptr& extension)
 {
+    if ( std::find(this->_registeredExtensions.begin(), this->_registeredExtensions.end(), extension) == this->_registeredExtensions.end() ) {
+        this->_registeredExtensions.push_back(extension);
+    }
 	return *this;
 }
 
 Markdown& Markdown::reset(void)
 {
-    this->htmlStash.reset();
-    this->references.clear();
     //! TODO: extension
 	return *this;
 }
 
 Markdown& Markdown::set_output_format(const output_formats format)
 {
+    this->_output_format = format;
     if ( format == html || format == html4 || format == html5 ) {
-        this->serializer = to_html_string;
+        this->serializer = write_html_string;
     } else if ( format == xhtml || format == xhtml1 || format == xhtml5 ) {
-        this->serializer = to_xhtml_string;
+        this->serializer = write_xhtml_string;
     }
 	return *this;
 }
 
-std::wstring Markdown::convert(const std::wstring& source)
+std::wstring Markdown::convert(const std::wstring& source) const
+{
+    std::wstring output;
+    this->convert(source, output);
+    return output;
+}
+
+void Markdown::convert(const std::wstring& source, std::wstring& output) const
+{
+    Context context;
+    this->convert(context, source, output);
+}
+
+void Markdown::convert(const std::wstring& source, std::ostream& output) const
+{
+    Context context;
+    this->convert(context, source, output);
+}
+
+void Markdown::convert(const std::wstring& source, const ChunkWriter& write) const
+{
+    Context context;
+    this->convert(context, source, write);
+}
+
+void Markdown::convert(Context& context, const std::wstring& source, std::wstring& output) const
+{
+    std::pair<std::size_t, std::size_t> range = this->render(context, source, output);
+    output.erase(range.second);
+    output.erase(0, range.first);
+}
+
+void Markdown::convert(Context& context, const std::wstring& source, std::ostream& output) const
+{
+    std::pair<std::size_t, std::size_t> range = this->render(context, source, context.outputBuffer);
+    write_utf8(output, context.outputBuffer.data()+range.first, range.second-range.first);
+}
+
+void Markdown::convert(Context& context, const std::wstring& source, const ChunkWriter& write) const
+{
+    std::pair<std::size_t, std::size_t> range = this->render(context, source, context.outputBuffer);
+    if ( range.first != range.second ) {
+        write(context.outputBuffer.data()+range.first, range.second-range.first);
+    }
+}
+
+std::pair<std::size_t, std::size_t> Markdown::render(Context& context, const std::wstring& source, std::wstring& output) const
 {
+    context.reset();
+    output.clear();
+    Context::Scope scope(context);
+    MARKDOWN_PROFILE("convert");
+    context.meter.start(this->_budget, source);
+
     //! Fixup the source text
-    if ( boost::algorithm::trim_copy(source).empty() ) {
-        return std::wstring();  //!< a blank unicode string
+    if ( boost::algorithm::all(source, boost::algorithm::is_space()) ) {
+        return std::make_pair(0, 0);  //!< a blank unicode string
 	}
 
-    std::wstring source_ = source;
-
-    //! Split into lines and run the line preprocessors.
-    std::list<std::wstring> lines;
-    boost::algorithm::split(lines, source_, boost::is_any_of(L"\n"));
-    for ( OrderedDictProcessors::Ptr pre : this->preprocessors.toList() ) {
-        lines = pre->run(lines);
+    //! Run the preprocessors.
+    std::wstring text = source;
+    for ( const std::string& key : this->preprocessors.keys() ) {
+        MARKDOWN_PROFILE("preprocessors."+key);
+        text = this->preprocessors[key]->runText(text);
     }
 
     //! Parse the high-level elements.
-    ElementTree doc = this->parser->parseDocument(lines);
+    ElementTree doc(ElementTree::InvalidElementTree);
+    {
+        MARKDOWN_PROFILE("parser");
+        doc = this->parser->parseDocument(text);
+    }
     Element root(doc);
 
     //! Run the tree-processors
-    for ( OrderedDictTreeProcessors::Ptr tree : this->treeprocessors.toList() ) {
-        Element newRoot = tree->run(root);
+    for ( const std::string& key : this->treeprocessors.keys() ) {
+        MARKDOWN_PROFILE("treeprocessors."+key);
+        Element newRoot = this->treeprocessors[key]->run(root);
         if ( ! newRoot.isNull() ) {
             root = newRoot;
         }
     }
 
     //! Serialize _properly_.  Strip top-level tags.
-    std::wstring output;
-    output = this->serializer(root);
+    {
+        MARKDOWN_PROFILE("serializer");
+        this->serializer(root, output);
+    }
     if ( this->stripTopLevelTags ) {
         std::wstring::size_type begin = output.find((boost::wformat(L"<%s>")%this->doc_tag()).str());
         std::wstring::size_type end   = output.rfind((boost::wformat(L"</%s>")%this->doc_tag()).str());
         if ( begin != std::wstring::npos && end != std::wstring::npos ) {
-            output = output.substr(begin+this->doc_tag().size()+2, end-this->doc_tag().size()-2);
+            output.erase(end);
+            output.erase(0, begin+this->doc_tag().size()+2);
         } else {
-            return std::wstring();
+            output.clear();
+            return std::make_pair(0, 0);
         }
     }
 
     //! Run the text post-processors
-    for ( OrderedDictPostProcessors::Ptr post : this->postprocessors.toList() ) {
-        output = post->run(output);
+    for ( const std::string& key : this->postprocessors.keys() ) {
+        MARKDOWN_PROFILE("postprocessors."+key);
+        this->postprocessors[key]->runInPlace(output);
     }
 
-    return boost::algorithm::trim_copy(output);
+    //! Trim by range; the sinks decide whether to copy.
+    std::size_t first = 0, last = output.size();
+    while ( first < last && std::iswspace(output[first]) ) {
+        ++first;
+    }
+    while ( last > first && std::iswspace(output[last-1]) ) {
+        --last;
+    }
+    return std::make_pair(first, last);
 }
 
-Markdown& Markdown::convertFile(/*input, output, encoding=L"utf-8"*/)
+std::string Markdown::convert(boost::string_view source) const
 {
+    Context context;
+    std::pair<std::size_t, std::size_t> range = this->render(context, utf8_decode(source), context.outputBuffer);
+    std::string result;
+    utf8_encode(context.outputBuffer.data()+range.first, range.second-range.first, result);
+    return result;
+}
+
+const Markdown& Markdown::convertFile(const std::string& input, std::ostream& output) const
+{
+    std::wstring text;
+    if ( input.empty() ) {
+        std::string buffer((std::istreambuf_iterator<char>(std::cin)), std::istreambuf_iterator<char>());
+        decode_source(buffer, text);
+    } else {
+        std::ifstream probe(input.c_str(), std::ios::binary | std::ios::ate);
+        if ( ! probe ) {
+            throw std::ios_base::failure("cannot open file: " + input);
+        }
+        //! mapping an empty file fails, and there is nothing to read anyway
+        if ( probe.tellg() > 0 ) {
+            probe.close();
+            boost::iostreams::mapped_file_source mapped(input);
+            decode_source(boost::string_view(mapped.data(), mapped.size()), text);
+        }
+    }
+
+    this->convert(text, output);
 	return *this;
 }
 
+const Markdown& Markdown::convertFile(const std::string& input, const std::string& output) const
+{
+    if ( output.empty() ) {
+        return this->convertFile(input, std::cout);
+    }
+    std::ofstream stream(output.c_str(), std::ios::binary);
+    if ( ! stream ) {
+        throw std::ios_base::failure("cannot open file: " + output);
+    }
+    return this->convertFile(input, stream);
+}
+
+std::vector<std::wstring> Markdown::convertBatch(const std::vector<std::wstring>& sources, unsigned int threads) const
+{
+    return this->convertBatch(sources.begin(), sources.end(), threads);
+}
+
+std::vector<std::wstring> Markdown::convertBatch(const std::vector<const std::wstring*>& sources, unsigned int threads) const
+{
+    std::vector<std::wstring> results(sources.size());
+    if ( threads == 0 ) {
+        threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+    threads = static_cast<unsigned int>(std::min<std::size_t>(threads, sources.size()));
+
+    std::atomic<std::size_t> next(0);
+    std::atomic<bool> failed(false);
+    std::exception_ptr error;
+    std::mutex error_mutex;
+    auto worker = [&](void){
+        Context context;
+        try {
+            for ( std::size_t i = next++; i < sources.size() && ! failed; i = next++ ) {
+                this->convert(context, *sources[i], results[i]);
+            }
+        } catch (...) {
+            std::lock_guard<std::mutex> lock(error_mutex);
+            if ( ! error ) {
+                error = std::current_exception();
+            }
+            failed = true;
+        }
+    };
+
+    std::vector<std::thread> pool;
+    pool.reserve(threads);
+    try {
+        for ( unsigned int i = 1; i < threads; ++i ) {
+            pool.emplace_back(worker);
+        }
+    } catch (...) {
+        //! the workers already started must be joined before the pool goes
+        failed = true;
+        next = sources.size();
+        for ( std::thread& thread : pool ) {
+            thread.join();
+        }
+        throw;
+    }
+    worker();
+    for ( std::thread& thread : pool ) {
+        thread.join();
+    }
+    if ( error ) {
+        std::rethrow_exception(error);
+    }
+    return results;
+}
+
 } // end of namespace markdown
@@ -40,8 +40,16 @@
  * License: BSD (see LICENSE for details).
  */
 
+#include <cstddef>
 #include <functional>
+#include <ostream>
+#include <utility>
+#include <vector>
 
+#include <boost/utility/string_view.hpp>
+
+#include "Budget.h"
+#include "Context.h"
 #include "Processor.h"
 #include "InlinePatterns.h"
 #include "TreeProcessors.h"
@@ -55,14 +63,21 @@ class BlockParser;  //!< forward declaration
 
 /*!
  * Convert Markdown to HTML.
+ *
+ * Once built (and extended), a Markdown instance is not modified by
+ * convert(): the per-document state lives in a Context, so one instance
+ * can serve concurrent conversions from any number of threads.
  */
 class Markdown{
 public:
-    typedef std::pair<std::wstring, std::wstring> ReferenceItem;
-    typedef std::map<std::wstring, ReferenceItem>  Reference;
+    typedef Context::ReferenceItem ReferenceItem;
+    typedef Context::Reference     Reference;
 
     typedef std::list<Extension::Ptr> Extensions;
 
+    //! Receives the converted html as one contiguous chunk.
+    typedef std::function<void(const wchar_t*, std::size_t)> ChunkWriter;
+
 public:
     typedef enum{
         default_mode,
@@ -107,6 +122,7 @@ public:
      * * enable_attributes: Enable the conversion of attributes. Default: True
      * * smart_emphasis: Treat `_connected_words_` intelegently Default: True
      * * lazy_ol: Ignore number of first item of ordered lists. Default: True
+     * * budget: Resource limits of each conversion. Default: unlimited
      *
      */
     Markdown(void);
@@ -129,10 +145,16 @@ public:
     Markdown& registerExtensions(const Extensions& extensions/*, configs*/);
     /*!
      * This gets called by the extension
+     *
+     * registerExtensions() records every extension it applies, so this
+     * only needs to be called for extensions set up by other means.
      */
     Markdown& registerExtension(const Extension::Ptr& extension);
     /*!
      * Resets all state variables so that we can start with a new text.
+     *
+     * The per-document state lives in Context and starts empty for every
+     * conversion; this is kept for extensions.
      */
 	Markdown& reset(void);
     /*!
@@ -159,28 +181,98 @@ public:
      * 5. The output is written to a string.
      *
      */
-    std::wstring convert(const std::wstring& source);
+    std::wstring convert(const std::wstring& source) const;
+    /*!
+     * Convert markdown into a caller-supplied buffer.
+     *
+     * `output` is cleared and receives the html; its capacity is kept, so
+     * a buffer reused across documents stops allocating once it is large
+     * enough. The document is serialized, stripped, post-processed and
+     * trimmed inside this one buffer.
+     *
+     */
+    void convert(const std::wstring& source, std::wstring& output) const;
+    /*!
+     * Convert markdown and write the html to `output` as UTF-8.
+     */
+    void convert(const std::wstring& source, std::ostream& output) const;
+    /*!
+     * Convert markdown and pass the html to `write` as a single chunk.
+     *
+     * The chunk points into an internal buffer and is only valid during
+     * the call.
+     *
+     */
+    void convert(const std::wstring& source, const ChunkWriter& write) const;
+    /*!
+     * Same as above, running the conversion in a caller-owned Context.
+     *
+     * The context is reset first. A worker that keeps one Context per
+     * thread reuses its stash and output buffers across documents.
+     *
+     */
+    void convert(Context& context, const std::wstring& source, std::wstring& output) const;
+    void convert(Context& context, const std::wstring& source, std::ostream& output) const;
+    void convert(Context& context, const std::wstring& source, const ChunkWriter& write) const;
+    /*!
+     * Convert UTF-8 encoded markdown to UTF-8 encoded HTML.
+     *
+     * The source is decoded once on entry and the result encoded once on
+     * exit; malformed input sequences are replaced by U+FFFD.
+     *
+     * Keyword arguments:
+     *
+     * * source: Source text as UTF-8 bytes.
+     *
+     */
+    std::string convert(boost::string_view source) const;
     /*!
-     * Converts a markdown file and returns the HTML as a unicode string.
+     * Converts a markdown file and writes the HTML to a stream or file.
+     *
+     * The input file is memory-mapped and decoded from UTF-8 in a single
+     * pass (a leading byte-order mark is dropped), passed to markdown, and
+     * the html is written to either the provided stream or the file with
+     * provided name. The output is encoded as UTF-8 in fixed size chunks,
+     * so no encoded copy of the whole document is built. Malformed input
+     * and unencodable output characters are replaced by U+FFFD.
      *
-     * Decodes the file using the provided encoding (defaults to utf-8),
-     * passes the file content to markdown, and outputs the html to either
-     * the provided stream or the file with provided name, using the same
-     * encoding as the source file. The 'xmlcharrefreplace' error handler is
-     * used when encoding the output.
+     * Keyword arguments:
+     *
+     * * input: Path of the input file. Reads from stdin if empty.
+     * * output: Stream or path. Writes to stdout if empty.
+     *
+     * Throws std::ios_base::failure if a file cannot be opened or mapped.
+     *
+     */
+	const Markdown& convertFile(const std::string& input, std::ostream& output) const;
+	const Markdown& convertFile(const std::string& input=std::string(), const std::string& output=std::string()) const;
+    /*!
+     * Convert a batch of documents on a pool of worker threads.
      *
-     * **Note:** This is the only place that decoding and encoding of unicode
-     * takes place in Python-Markdown.  (All other code is unicode-in /
-     * unicode-out.)
+     * The documents are handed out one at a time to the workers, each of
+     * which converts with its own Context, so long and short documents
+     * balance out. The calling thread is one of the workers.
      *
      * Keyword arguments:
      *
-     * * input: File object or path. Reads from stdin if `None`.
-     * * output: File object or path. Writes to stdout if `None`.
-     * * encoding: Encoding of input and output files. Defaults to utf-8.
+     * * sources: The documents, or a [first, last) range of std::wstring.
+     * * threads: Number of workers. 0 uses std::thread::hardware_concurrency().
+     *
+     * Returns the html of each document, in the order of the sources. If a
+     * conversion throws, the remaining documents are skipped and the first
+     * exception is rethrown once every worker has stopped.
      *
      */
-	Markdown& convertFile(/*input, output, encoding=L"utf-8"*/);
+    std::vector<std::wstring> convertBatch(const std::vector<std::wstring>& sources, unsigned int threads=0) const;
+    template<typename Iterator>
+    std::vector<std::wstring> convertBatch(Iterator first, Iterator last, unsigned int threads=0) const
+    {
+        std::vector<const std::wstring*> sources;
+        for ( ; first != last; ++first ) {
+            sources.push_back(&*first);
+        }
+        return this->convertBatch(sources, threads);
+    }
 
 public:
     std::wstring doc_tag(void) const
@@ -218,6 +310,21 @@ public:
 	void setSafeMode(safe_mode_type mode)
 	{ this->_safeMode = mode; }
 
+    /*!
+     * Limits applied to every conversion; one that exceeds them throws
+     * BudgetExceeded and produces no output.
+     */
+    const Budget& budget(void) const
+    { return this->_budget; }
+    void set_budget(const Budget& budget)
+    { this->_budget = budget; }
+
+    output_formats output_format(void) const
+    { return this->_output_format; }
+
+    const Extensions& registeredExtensions(void) const
+    { return this->_registeredExtensions; }
+
 private:
     std::wstring _doc_tag;  //!< Element used to wrap document -later removed
 
@@ -227,14 +334,24 @@ private:
 	bool          _smart_emphasis;
 	bool          _lazy_ol;
 
-    //output_formats
+    output_formats _output_format;
 
 	safe_mode_type _safeMode;
 
-	//registeredExtensions
+    Budget _budget;
+
+	Extensions _registeredExtensions;
 	//docType
 	bool stripTopLevelTags;
 
+    /*!
+     * Run the whole pipeline into `output` and return the [first, last)
+     * offsets of the html with surrounding whitespace left in place.
+     */
+    std::pair<std::size_t, std::size_t> render(Context& context, const std::wstring& source, std::wstring& output) const;
+
+    std::vector<std::wstring> convertBatch(const std::vector<const std::wstring*>& sources, unsigned int threads) const;
+
 public:
     std::set<wchar_t> ESCAPED_CHARS;
 
@@ -244,10 +361,8 @@ public:
     OrderedDictTreeProcessors treeprocessors;
     OrderedDictPostProcessors postprocessors;
 
-    Reference references;
-	HtmlStash htmlStash;
 
-    std::function<std::wstring(Element&)> serializer;
+    std::function<void(Element&, std::wstring&)> serializer;
 
 };
 
@@ -7,12 +7,17 @@
 
 #include "PostProcessors.h"
 
+#ifdef USE_QT
 #include <QString>
+#else
+#include <cwchar>
+#endif
 
 #include <boost/algorithm/string.hpp>
 #include <boost/format.hpp>
 
 #include "MarkdownCpp.h"
+#include "Context.h"
 
 namespace markdown{
 
@@ -23,6 +28,11 @@ PostProcessor::PostProcessor(Markdown *markdown_instance) :
 PostProcessor::~PostProcessor(void)
 {}
 
+void PostProcessor::runInPlace(std::wstring& text)
+{
+    text = this->run(text);
+}
+
 /*!
  * Restore raw html to the document.
  */
@@ -30,7 +40,8 @@ class RawHtmlPostprocessor : public PostProcessor
 {
 public:
     RawHtmlPostprocessor(Markdown* markdown_instance) :
-        PostProcessor(markdown_instance)
+        PostProcessor(markdown_instance),
+        TAG_RE(RegexCache::get(L"^\\<\\/?([^ >]+)"))
     {}
 
     /*!
@@ -39,8 +50,15 @@ public:
     std::wstring run(const std::wstring &text)
     {
         std::wstring result = text;
-        for ( int i = 0; i < this->markdown->htmlStash.html_counter; ++i ) {
-            HtmlStash::Item item = this->markdown->htmlStash.rawHtmlBlocks[i];
+        this->runInPlace(result);
+        return result;
+    }
+
+    void runInPlace(std::wstring& result)
+    {
+        const HtmlStash& htmlStash = Context::current().htmlStash;
+        for ( int i = 0; i < htmlStash.html_counter; ++i ) {
+            HtmlStash::Item item = htmlStash.rawHtmlBlocks[i];
             std::wstring html = item.first;
             bool safe = item.second;
             if ( this->markdown->safeMode() != Markdown::default_mode && ! safe ) {
@@ -53,11 +71,10 @@ public:
                 }
             }
             if ( this->isblocklevel(html) && ( safe || ! this->markdown->safeMode() ) ) {
-                result = boost::algorithm::replace_all_copy(result, (boost::wformat(L"<p>%s</p>")%this->markdown->htmlStash.get_placeholder(i)).str(), html+L"\n");
+                boost::algorithm::replace_all(result, (boost::wformat(L"<p>%s</p>")%htmlStash.get_placeholder(i)).str(), html+L"\n");
             }
-            result = boost::algorithm::replace_all_copy(result, this->markdown->htmlStash.get_placeholder(i), html);
+            boost::algorithm::replace_all(result, htmlStash.get_placeholder(i), html);
         }
-        return result;
     }
 
     /*!
@@ -76,7 +93,7 @@ public:
     bool isblocklevel(const std::wstring& html)
     {
         boost::wsmatch m;
-        if ( boost::regex_match(html, boost::wregex(L"^\\<\\/?([^ >]+)")) ) {
+        if ( boost::regex_match(html, this->TAG_RE) ) {
             wchar_t wch = m.str(1).at(0);
             // SPECIAL_CHARS: !, ?, @, %
             if ( SPECIAL_CHARS.find(wch) != SPECIAL_CHARS.end() ) {
@@ -89,6 +106,7 @@ public:
     }
 
 private:
+    const boost::wregex TAG_RE;
     static const std::set<wchar_t> SPECIAL_CHARS;
 
 };
@@ -110,6 +128,11 @@ public:
         return boost::algorithm::replace_all_copy(text, util::AMP_SUBSTITUTE, L"&");
     }
 
+    void runInPlace(std::wstring& text)
+    {
+        boost::algorithm::replace_all(text, util::AMP_SUBSTITUTE, L"&");
+    }
+
 };
 
 /*!
@@ -120,18 +143,56 @@ class UnescapePostprocessor : public PostProcessor
 public:
     UnescapePostprocessor(Markdown* markdown_instance=nullptr) :
         PostProcessor(markdown_instance),
-        RE((boost::wformat(L"%s(\\d+)%s")%util::STX%util::ETX).str())
+        RE(RegexCache::get((boost::wformat(L"%s(\\d+)%s")%util::STX%util::ETX).str()))
     {}
 
     std::wstring run(const std::wstring &text)
     {
         auto unescape = [](const boost::wsmatch& m) -> std::wstring {
+#ifdef USE_QT
             int i = QString::fromStdWString(m.str(1)).toInt();
             return QString(QChar(i)).toStdWString();
+#else
+            const unsigned long code = std::wcstoul(m.str(1).c_str(), nullptr, 10);
+            return std::wstring(1, static_cast<wchar_t>(code <= 0x10FFFF ? code : 0));
+#endif
         };
         return boost::regex_replace(text, this->RE, unescape);
     }
 
+    /*!
+     * Same as `run`, but compacts the buffer in place: every replacement
+     * is shorter than the STX/digits/ETX sequence it replaces.
+     */
+    void runInPlace(std::wstring& text)
+    {
+        std::wstring::size_type pos = text.find(util::STX);
+        if ( pos == std::wstring::npos ) {
+            return;
+        }
+        std::wstring::iterator out = text.begin() + pos;
+        std::wstring::const_iterator it = out, end = text.end();
+        while ( it != end ) {
+            if ( *it == util::STX[0] ) {
+                std::wstring::const_iterator digits = it + 1, last = digits;
+                int code = 0;
+                while ( last != end && *last >= L'0' && *last <= L'9' ) {
+                    if ( code <= 0x10FFFF ) {
+                        code = code * 10 + (*last - L'0');
+                    }
+                    ++last;
+                }
+                if ( last != digits && last != end && *last == util::ETX[0] && code <= 0x10FFFF ) {
+                    *out++ = static_cast<wchar_t>(code);
+                    it = last + 1;
+                    continue;
+                }
+            }
+            *out++ = *it++;
+        }
+        text.erase(out, text.end());
+    }
+
 private:
     boost::wregex RE;
 
@@ -18,6 +18,8 @@
  *
  */
 
+#include <string>
+
 #include "odict.h"
 
 namespace markdown{
@@ -46,6 +48,14 @@ public:
      *
      */
     virtual std::wstring run(const std::wstring& text) = 0;
+    /*!
+     * Modify the html document in place.
+     *
+     * The default calls `run` and assigns the result back; postprocessors
+     * on the hot path override it to edit the buffer without a copy.
+     *
+     */
+    virtual void runInPlace(std::wstring& text);
 
 public:
     Markdown* markdown;
@@ -7,15 +7,35 @@
 
 #include "PreProcessors.h"
 
+#include <algorithm>
+
 #include <boost/algorithm/string.hpp>
 #include <boost/format.hpp>
 #include <boost/tuple/tuple.hpp>
 
 #include "MarkdownCpp.h"
+#include "Context.h"
 #include "util.h"
 
 namespace markdown{
 
+std::wstring Processor::runText(const std::wstring& text)
+{
+    return Processor::joinLines(this->run(Processor::splitLines(text)));
+}
+
+std::list<std::wstring> Processor::splitLines(const std::wstring& text)
+{
+    std::list<std::wstring> lines;
+    boost::algorithm::split(lines, text, boost::is_any_of(L"\n"));
+    return lines;
+}
+
+std::wstring Processor::joinLines(const std::list<std::wstring>& lines)
+{
+    return boost::algorithm::join(lines, L"\n");
+}
+
 class PreProcessor : public Processor
 {
 public:
@@ -33,26 +53,34 @@ class NormalizeWhitespace : public PreProcessor
 {
 public:
 	NormalizeWhitespace(Markdown* markdown_instance) :
-		PreProcessor(markdown_instance)
+		PreProcessor(markdown_instance),
+		BLANK_LINE_RE(RegexCache::get(L"(?<=\n) +\n"))
 	{}
 	virtual ~NormalizeWhitespace(void)
 	{}
 
     std::list<std::wstring> run(const std::list<std::wstring>& lines)
 	{
-        std::wstring source = boost::algorithm::join(lines, L"\n");
+        return Processor::splitLines(this->runText(Processor::joinLines(lines)));
+	}
+
+    std::wstring runText(const std::wstring& text)
+	{
+        std::wstring source = text;
         boost::algorithm::replace_all(source, util::STX, std::wstring());
         boost::algorithm::replace_all(source, util::ETX, std::wstring());
 		boost::algorithm::replace_all(source, L"\r\n", L"\n");
 		boost::algorithm::replace_all(source, L"\r", L"\n");
 		source += L"\n\n";
         boost::algorithm::replace_all(source, L"\t", std::wstring(this->markdown->tab_length(), L' '));
-		source = boost::regex_replace(source, boost::wregex(L"(?<=\n) +\n"), L"\n");
-        std::list<std::wstring> result;
-		boost::algorithm::split(result, source, boost::is_any_of(L"\n"));
-		return result;
+		source = boost::regex_replace(source, this->BLANK_LINE_RE, L"\n");
+		return source;
 	}
 
+private:
+	//! Whitespace-only lines
+	const boost::wregex BLANK_LINE_RE;
+
 };
 
 /*!
@@ -68,9 +96,11 @@ public:
 		PreProcessor(markdown_instance),
 		right_tag_patterns({L"</%s>", L"/%s>"}),
         attrs_pattern(L"\\s+(?<attr>[^>\"'/= ]+)=(?<q>['\"])(?<value>.*?)\\g{q}|\\s+(?<attr1>[^>\"'/= ]+)=(?<value1>[^> ]+)|\\s+(?<attr2>[^>\"'/= ]+)"),
-        left_tag_pattern((boost::wformat(L"^<(?<tag>[^> ]+)(?<attrs>(%s)*)\\s*\\/?>?")%this->attrs_pattern).str()),
-        attrs_re(this->attrs_pattern),
-        left_tag_re(this->left_tag_pattern),
+        left_tag_pattern(L"^<(?<tag>[^> ]+)"),
+        attrs_re(RegexCache::get(this->attrs_pattern)),
+        left_tag_re(RegexCache::get(this->left_tag_pattern)),
+        left_tag_end_re(RegexCache::get(L"\\s*\\/?>?")),
+        markdown_attr_re(RegexCache::get(L"\\smarkdown(=['\"]?[^> ]*['\"]?)?")),
 		markdown_in_raw(false)
 	{}
 	virtual ~HtmlBlockProcessor(void)
@@ -78,7 +108,12 @@ public:
 
     std::list<std::wstring> run(const std::list<std::wstring>& lines)
 	{
-        std::wstring text = boost::algorithm::join(lines, L"\n");
+        return Processor::splitLines(this->runText(Processor::joinLines(lines)));
+	}
+
+    std::wstring runText(const std::wstring& source)
+	{
+        std::wstring text = source;
         std::list<std::wstring> new_blocks;
         std::list<std::wstring> texts;
 		// python str.rsplit()
@@ -99,7 +134,9 @@ public:
 		int left_index;
         std::size_t data_index;
 		bool in_tag = false;  //!< flag
+        BudgetMeter& meter = Context::current().meter;
 		while ( texts.size() > 0 ) {
+            meter.step();
             std::wstring block = texts.front();
 			if ( block[0] == L'\n' ) {
 				block = block.substr(1, block.size()-1);
@@ -148,15 +185,15 @@ public:
                     std::wstring buff = boost::algorithm::trim_right_copy(block);
 					if ( buff[buff.size()-1] == L'>' && this->equal_tags(left_tag, right_tag) ) {
                         if ( this->markdown_in_raw && attrs.find(L"markdown") != attrs.end() ) {
-                            std::wstring start = boost::regex_replace(block.substr(0, left_index), boost::wregex(L"\\smarkdown(=['\"]?[^> ]*['\"]?)?"), std::wstring());
+                            std::wstring start = boost::regex_replace(block.substr(0, left_index), this->markdown_attr_re, std::wstring());
 							int begin = block.size()-right_tag.size()-2;
                             std::wstring end   = block.substr(begin, block.size()-begin);
 							block = block.substr(left_index, begin-left_index);
-							new_blocks.push_back(this->markdown->htmlStash.store(start));
+							new_blocks.push_back(Context::current().htmlStash.store(start));
 							new_blocks.push_back(block);
-							new_blocks.push_back(this->markdown->htmlStash.store(end));
+							new_blocks.push_back(Context::current().htmlStash.store(end));
 						} else {
-							new_blocks.push_back(this->markdown->htmlStash.store(boost::algorithm::trim_copy(block)));
+							new_blocks.push_back(Context::current().htmlStash.store(boost::algorithm::trim_copy(block)));
 						}
 						continue;
 					} else {
@@ -167,7 +204,7 @@ public:
 							items.push_back(boost::algorithm::trim_copy(block));
 							in_tag = true;
 						} else {
-							new_blocks.push_back(this->markdown->htmlStash.store(boost::algorithm::trim_copy(block)));
+							new_blocks.push_back(Context::current().htmlStash.store(boost::algorithm::trim_copy(block)));
 						}
 
 						continue;
@@ -194,16 +231,16 @@ public:
 
 					in_tag = false;
                     if (this->markdown_in_raw && attrs.find(L"markdown") != attrs.end() ) {
-                        std::wstring start = boost::regex_replace(items.front().substr(0, left_index), boost::wregex(L"\\smarkdown(=['\"]?[^> ]*['\"]?)?"), std::wstring());
+                        std::wstring start = boost::regex_replace(items.front().substr(0, left_index), this->markdown_attr_re, std::wstring());
 						items.front() = items.front().substr(left_index, items.front().size()-left_index);
 						int begin = items.back().size()-right_tag.size()-2;
                         std::wstring end = items.back().substr(begin, items.back().size()-begin);
 						items.back() = items.back().substr(0, begin);
-						new_blocks.push_back(this->markdown->htmlStash.store(start));
+						new_blocks.push_back(Context::current().htmlStash.store(start));
                         for ( const std::wstring& item : items ) {
 							new_blocks.push_back(item);
 						}
-						new_blocks.push_back(this->markdown->htmlStash.store(end));
+						new_blocks.push_back(Context::current().htmlStash.store(end));
 					} else {
 						new_blocks.push_back(boost::algorithm::join(items, L"\n\n"));
 					}
@@ -213,64 +250,68 @@ public:
 		}
 		if ( items.size() > 0 ) {
 			if ( this->markdown_in_raw && attrs.find(L"markdown") != attrs.end() ) {
-                std::wstring start = boost::regex_replace(items.front().substr(0, left_index), boost::wregex(L"\\smarkdown(=['\"]?[^> ]*['\"]?)?"), std::wstring());
+                std::wstring start = boost::regex_replace(items.front().substr(0, left_index), this->markdown_attr_re, std::wstring());
 				items.front() = items.front().substr(left_index, items.front().size()-left_index);
 				int begin = items.back().size()-right_tag.size()-2;
                 std::wstring end = items.back().substr(begin, items.back().size()-begin);
 				items.back() = items.back().substr(0, begin);
-				new_blocks.push_back(this->markdown->htmlStash.store(start));
+				new_blocks.push_back(Context::current().htmlStash.store(start));
                 for ( const std::wstring& item : items ) {
 					new_blocks.push_back(item);
 				}
-				new_blocks.push_back(this->markdown->htmlStash.store(end));
+				new_blocks.push_back(Context::current().htmlStash.store(end));
 			} else {
 				new_blocks.push_back(boost::algorithm::join(items, L"\n\n"));
 			}
-			//new_blocks.push_back(this->markdown->htmlStash.store(boost::algorithm::join(items, L"\n\n")));
+			//new_blocks.push_back(Context::current().htmlStash.store(boost::algorithm::join(items, L"\n\n")));
 			new_blocks.push_back(L"\n");
 		}
-        std::wstring new_text = boost::algorithm::join(new_blocks, L"\n\n");
-        std::list<std::wstring> result;
-		boost::algorithm::split(result, new_text, boost::is_any_of(L"\n"));
-		return result;
+        return boost::algorithm::join(new_blocks, L"\n\n");
 	}
 
 private:
+    /*!
+     * The tag and the attributes are matched one at a time, each as a
+     * prefix of the rest like re.match() does. Python-Markdown matches
+     * the tag, any number of attributes and the tag end in one regular
+     * expression, which runs boost out of stack on a line of thousands of
+     * attributes. The tag end may be empty, so the repetition never
+     * backtracks and the result is the same.
+     */
     boost::tuples::tuple<std::wstring, int, Attributes> get_left_tag(const std::wstring& block)
 	{
 		boost::wsmatch m;
-		if ( boost::regex_match(block, m, this->left_tag_re) ) {
+		if ( boost::regex_search(block, m, this->left_tag_re, boost::match_continuous) ) {
             std::wstring tag = m[L"tag"];
-            std::wstring raw_attrs = m[L"attrs"];
 			Attributes attrs;
-			if ( ! raw_attrs.empty() ) {
-                std::wstring::const_iterator begin = raw_attrs.begin(), end = raw_attrs.end();
-				boost::wsmatch ma;
-				while ( boost::regex_search(begin, end, ma, this->attrs_re) ) {
-                    if ( ! std::wstring(ma[L"attr"]).empty() ) {
-                        std::wstring attr = ma[L"attr"];
-						boost::algorithm::trim(attr);
-                        if ( ! std::wstring(ma[L"value"]).empty() ) {
-							attrs[attr] = ma[L"value"];
-						} else {
-                            attrs[attr] = std::wstring();
-						}
-                    } else if ( ! std::wstring(ma[L"attr1"]).empty() ) {
-                        std::wstring attr1 = ma[L"attr1"];
-						boost::algorithm::trim(attr1);
-                        if ( ! std::wstring(ma[L"value1"]).empty() ) {
-							attrs[attr1] = ma[L"value1"];
-						} else {
-                            attrs[attr1] = std::wstring();
-						}
-                    } else if ( ! std::wstring(ma[L"attr2"]).empty() ) {
-                        std::wstring attr2 = ma[L"attr2"];
-						boost::algorithm::trim(attr2);
-                        attrs[attr2] = std::wstring();
+            std::wstring::const_iterator begin = m[0].second, end = block.end();
+			boost::wsmatch ma;
+			while ( boost::regex_search(begin, end, ma, this->attrs_re, boost::match_continuous | boost::match_prev_avail) ) {
+                if ( ! std::wstring(ma[L"attr"]).empty() ) {
+                    std::wstring attr = ma[L"attr"];
+					boost::algorithm::trim(attr);
+                    if ( ! std::wstring(ma[L"value"]).empty() ) {
+						attrs[attr] = ma[L"value"];
+					} else {
+                        attrs[attr] = std::wstring();
+					}
+                } else if ( ! std::wstring(ma[L"attr1"]).empty() ) {
+                    std::wstring attr1 = ma[L"attr1"];
+					boost::algorithm::trim(attr1);
+                    if ( ! std::wstring(ma[L"value1"]).empty() ) {
+						attrs[attr1] = ma[L"value1"];
+					} else {
+                        attrs[attr1] = std::wstring();
 					}
+                } else if ( ! std::wstring(ma[L"attr2"]).empty() ) {
+                    std::wstring attr2 = ma[L"attr2"];
+					boost::algorithm::trim(attr2);
+                    attrs[attr2] = std::wstring();
 				}
-            }
-            return boost::tuples::make_tuple(tag, m.str(0).size(), attrs);
+				begin = ma[0].second;
+			}
+			boost::regex_search(begin, end, ma, this->left_tag_end_re, boost::match_continuous | boost::match_prev_avail);
+            return boost::tuples::make_tuple(tag, ma[0].second - block.begin(), attrs);
 		} else {
             std::wstring tag = block.substr(1, block.find(L'>'));
             std::transform(tag.begin(), tag.end(), tag.begin(), ::tolower);
@@ -279,7 +320,10 @@ private:
 	}
     int recursive_tagfind(const std::wstring& ltag, const std::wstring& rtag, int start_index, const std::wstring& block)
 	{
+        BudgetMeter& meter = Context::current().meter;
+        BudgetMeter::Nesting nesting(meter);
 		while ( true ) {
+            meter.step();
             std::wstring::size_type i = block.find(rtag, start_index);
             if ( i == std::wstring::npos ) {
 				return -1;
@@ -312,9 +356,10 @@ private:
 			}
 		}
         std::wstring result = boost::algorithm::trim_right_copy(block);
-		int begin = result.size()-left_index;
-		int count = result.size()-begin-1;
-		result = result.substr(result.size()-left_index, count);
+		//! python block.rstrip()[-left_index:-1]
+		int begin = std::max<int>(0, result.size()-left_index);
+		int count = std::max<int>(0, static_cast<int>(result.size())-begin-1);
+		result = result.substr(begin, count);
 		std::transform(result.begin(), result.end(), result.begin(), ::tolower);
         return boost::tuples::make_tuple(result, block.size());
 	}
@@ -347,6 +392,8 @@ private:
 	std::wstring              left_tag_pattern;
 	boost::wregex             attrs_re;
 	boost::wregex             left_tag_re;
+	boost::wregex             left_tag_end_re;
+	boost::wregex             markdown_attr_re;
 	bool                      markdown_in_raw;
 
 };
@@ -360,19 +407,33 @@ public:
 	ReferencePreprocessor(Markdown* markdown_instance) :
 		PreProcessor(markdown_instance),
 		TITLE(L"[ ]*(\\\"(.*)\\\"|\\'(.*)\\'|\\((.*)\\))[ ]*"),
-		RE((boost::wformat(L"^[ ]{0,3}\\[([^\\]]*)\\]:\\s*([^ ]*)[ ]*(%s)?$")%TITLE).str(), boost::regex_constants::mod_s),
-		TITLE_RE((boost::wformat(L"^%s$")%TITLE).str())
+		RE(RegexCache::get((boost::wformat(L"^[ ]{0,3}\\[([^\\]]*)\\]:\\s*([^ ]*)[ ]*(%s)?$")%TITLE).str(), boost::regex_constants::mod_s)),
+		TITLE_RE(RegexCache::get((boost::wformat(L"^%s$")%TITLE).str()))
 	{}
 
     std::list<std::wstring> run(const std::list<std::wstring>& lines)
 	{
-        std::list<std::wstring> buffer = lines;
-        std::list<std::wstring> new_text;
-		while ( buffer.size() > 0 ) {
-            std::wstring line = buffer.front();
-			buffer.pop_front();
+        return Processor::splitLines(this->runText(Processor::joinLines(lines)));
+	}
+
+    /*!
+     * Scan the text line by line in place; kept lines are copied to the
+     * result as they are found.
+     */
+    std::wstring runText(const std::wstring& text)
+	{
+        typedef std::wstring::const_iterator Iterator;
+        auto next_line = [&](Iterator it) -> Iterator {
+            return std::find(it, text.end(), L'\n');
+        };
+        std::wstring new_text;
+        new_text.reserve(text.size());
+        bool first = true;
+        Iterator begin = text.begin();
+		while ( true ) {
+            Iterator end = next_line(begin);
 			boost::wsmatch m;
-			if ( boost::regex_match(line, m, this->RE) ) {
+			if ( boost::regex_match(begin, end, m, this->RE) ) {
                 std::wstring id = boost::algorithm::trim_copy(m.str(1));
 				std::transform(id.begin(), id.end(), id.begin(), ::tolower);
                 std::wstring link = m.str(2);
@@ -385,12 +446,13 @@ public:
 						break;
 					}
 				}
-				if ( ! ( m.str(5).size() > 0 || m.str(6).size() > 0 || m.str(7).size() > 0 ) ) {
+				if ( ! ( m.str(5).size() > 0 || m.str(6).size() > 0 || m.str(7).size() > 0 ) && end != text.end() ) {
 					//! Check next line for title
 					boost::wsmatch tm;
-                    std::wstring regexTmp = buffer.front();
-                    if ( boost::regex_match(regexTmp, tm, this->TITLE_RE) ) {
-						buffer.pop_front();
+                    Iterator title_begin = end + 1;
+                    Iterator title_end = next_line(title_begin);
+                    if ( boost::regex_match(title_begin, title_end, tm, this->TITLE_RE) ) {
+                        end = title_end;
 						for ( int i = 2; i <= 4; ++i ) {
 							t = m.str(i);
 							if ( t.size() > 0 ) {
@@ -399,10 +461,18 @@ public:
 						}
 					}
 				}
-                this->markdown->references[id] = Markdown::ReferenceItem(link, t);
+                Context::current().references[id] = Context::ReferenceItem(link, t);
 			} else {
-				new_text.push_back(line);
+                if ( ! first ) {
+                    new_text.push_back(L'\n');
+                }
+                new_text.append(begin, end);
+                first = false;
 			}
+            if ( end == text.end() ) {
+                break;
+            }
+            begin = end + 1;
 		}
 		return new_text;
 	}
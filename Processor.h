@@ -9,6 +9,7 @@
 #define PROCESSOR_H_
 
 #include <list>
+#include <string>
 
 #include "odict.h"
 
@@ -26,6 +27,18 @@ public:
 	{}
 
     virtual std::list<std::wstring> run(const std::list<std::wstring>& lines) = 0;
+    /*!
+     * Run the processor over the source as a single string.
+     *
+     * The default implementation splits `text` into lines, calls run() and
+     * joins the result again. Processors that work on the joined text
+     * override this to skip the round trip.
+     */
+    virtual std::wstring runText(const std::wstring& text);
+
+protected:
+    static std::list<std::wstring> splitLines(const std::wstring& text);
+    static std::wstring joinLines(const std::list<std::wstring>& lines);
 
 protected:
 	Markdown* markdown;
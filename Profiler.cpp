@@ -0,0 +1,310 @@
+/*
+ * Profiler.cpp
+ *
+ *  Created on: 2026/10/17
+ *      Author: mugwort_rc
+ */
+
+#include "Profiler.h"
+
+#ifdef USE_PROFILING
+
+#include <cstdlib>
+#include <mutex>
+#include <new>
+#include <sstream>
+
+#include "Context.h"
+
+namespace {
+
+thread_local std::size_t allocated_bytes = 0;
+thread_local std::size_t allocation_count = 0;
+
+//! nullptr when out of memory
+void* counted_malloc(std::size_t size) noexcept
+{
+    void* ptr = std::malloc(size ? size : 1);
+    if ( ptr != nullptr ) {
+        allocated_bytes += size;
+        ++allocation_count;
+    }
+    return ptr;
+}
+
+//! Like the default operator new: retry after each call of the
+//! new_handler, and throw bad_alloc when there is none.
+void* counted_new(std::size_t size)
+{
+    void* ptr;
+    while ( ( ptr = counted_malloc(size) ) == nullptr ) {
+        std::new_handler handler = std::get_new_handler();
+        if ( handler == nullptr ) {
+            throw std::bad_alloc();
+        }
+        handler();
+    }
+    return ptr;
+}
+
+//! Like the default nothrow operator new: the new_handler may throw.
+void* counted_nothrow_new(std::size_t size) noexcept
+{
+    try {
+        return counted_new(size);
+    } catch ( ... ) {
+        return nullptr;
+    }
+}
+
+#ifdef __cpp_aligned_new
+void* counted_aligned_malloc(std::size_t size, std::align_val_t align) noexcept
+{
+    const std::size_t alignment = static_cast<std::size_t>(align);
+    //! aligned_alloc() takes a multiple of the alignment
+    void* ptr = std::aligned_alloc(alignment, ( (size ? size : 1) + alignment - 1 ) / alignment * alignment);
+    if ( ptr != nullptr ) {
+        allocated_bytes += size;
+        ++allocation_count;
+    }
+    return ptr;
+}
+
+void* counted_aligned_new(std::size_t size, std::align_val_t align)
+{
+    void* ptr;
+    while ( ( ptr = counted_aligned_malloc(size, align) ) == nullptr ) {
+        std::new_handler handler = std::get_new_handler();
+        if ( handler == nullptr ) {
+            throw std::bad_alloc();
+        }
+        handler();
+    }
+    return ptr;
+}
+
+void* counted_aligned_nothrow_new(std::size_t size, std::align_val_t align) noexcept
+{
+    try {
+        return counted_aligned_new(size, align);
+    } catch ( ... ) {
+        return nullptr;
+    }
+}
+#endif
+
+} // end of anonymous namespace
+
+//! Count every allocation of the process; the profiler reads the
+//! per-thread totals at the start and end of each stage. Each form is
+//! replaced, so that none bypasses the count or frees what another
+//! allocated.
+void* operator new(std::size_t size)
+{
+    return counted_new(size);
+}
+
+void* operator new[](std::size_t size)
+{
+    return counted_new(size);
+}
+
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept
+{
+    return counted_nothrow_new(size);
+}
+
+void* operator new[](std::size_t size, const std::nothrow_t&) noexcept
+{
+    return counted_nothrow_new(size);
+}
+
+void operator delete(void* ptr) noexcept
+{
+    std::free(ptr);
+}
+
+void operator delete[](void* ptr) noexcept
+{
+    std::free(ptr);
+}
+
+void operator delete(void* ptr, const std::nothrow_t&) noexcept
+{
+    std::free(ptr);
+}
+
+void operator delete[](void* ptr, const std::nothrow_t&) noexcept
+{
+    std::free(ptr);
+}
+
+#ifdef __cpp_sized_deallocation
+void operator delete(void* ptr, std::size_t) noexcept
+{
+    std::free(ptr);
+}
+
+void operator delete[](void* ptr, std::size_t) noexcept
+{
+    std::free(ptr);
+}
+#endif
+
+#ifdef __cpp_aligned_new
+void* operator new(std::size_t size, std::align_val_t align)
+{
+    return counted_aligned_new(size, align);
+}
+
+void* operator new[](std::size_t size, std::align_val_t align)
+{
+    return counted_aligned_new(size, align);
+}
+
+void* operator new(std::size_t size, std::align_val_t align, const std::nothrow_t&) noexcept
+{
+    return counted_aligned_nothrow_new(size, align);
+}
+
+void* operator new[](std::size_t size, std::align_val_t align, const std::nothrow_t&) noexcept
+{
+    return counted_aligned_nothrow_new(size, align);
+}
+
+void operator delete(void* ptr, std::align_val_t) noexcept
+{
+    std::free(ptr);
+}
+
+void operator delete[](void* ptr, std::align_val_t) noexcept
+{
+    std::free(ptr);
+}
+
+void operator delete(void* ptr, std::size_t, std::align_val_t) noexcept
+{
+    std::free(ptr);
+}
+
+void operator delete[](void* ptr, std::size_t, std::align_val_t) noexcept
+{
+    std::free(ptr);
+}
+
+void operator delete(void* ptr, std::align_val_t, const std::nothrow_t&) noexcept
+{
+    std::free(ptr);
+}
+
+void operator delete[](void* ptr, std::align_val_t, const std::nothrow_t&) noexcept
+{
+    std::free(ptr);
+}
+#endif
+
+namespace markdown{
+
+namespace {
+
+std::mutex global_mutex;
+
+Profile& global_profile(void)
+{
+    static Profile profile;
+    return profile;
+}
+
+} // end of anonymous namespace
+
+void Profile::add(const std::string& name, const Stat& stat)
+{
+    Stat& total = this->_stats[name];
+    total.calls       += stat.calls;
+    total.nanoseconds += stat.nanoseconds;
+    total.bytes       += stat.bytes;
+    total.allocations += stat.allocations;
+}
+
+void Profile::merge(const Profile& other)
+{
+    for ( const Stats::value_type& item : other._stats ) {
+        this->add(item.first, item.second);
+    }
+}
+
+void Profile::clear(void)
+{
+    this->_stats.clear();
+}
+
+std::string Profile::toJSON(void) const
+{
+    std::ostringstream out;
+    out << "{";
+    bool first = true;
+    for ( const Stats::value_type& item : this->_stats ) {
+        if ( ! first ) {
+            out << ", ";
+        }
+        first = false;
+        //! stage names are processor keys: no quotes or control characters
+        out << "\"" << item.first << "\": {"
+            << "\"calls\": " << item.second.calls << ", "
+            << "\"nanoseconds\": " << item.second.nanoseconds << ", "
+            << "\"bytes\": " << item.second.bytes << ", "
+            << "\"allocations\": " << item.second.allocations << "}";
+    }
+    out << "}";
+    return out.str();
+}
+
+Profile Profile::global(void)
+{
+    std::lock_guard<std::mutex> lock(global_mutex);
+    return global_profile();
+}
+
+void Profile::resetGlobal(void)
+{
+    std::lock_guard<std::mutex> lock(global_mutex);
+    global_profile().clear();
+}
+
+std::size_t Profile::allocatedBytes(void)
+{
+    return allocated_bytes;
+}
+
+std::size_t Profile::allocationCount(void)
+{
+    return allocation_count;
+}
+
+Profile::Scope::Scope(const std::string& name) :
+    name(name),
+    start(std::chrono::steady_clock::now()),
+    bytes(allocated_bytes),
+    allocations(allocation_count)
+{}
+
+Profile::Scope::~Scope(void)
+{
+    Stat stat;
+    stat.calls       = 1;
+    stat.nanoseconds = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now()-this->start).count();
+    stat.bytes       = allocated_bytes - this->bytes;
+    stat.allocations = allocation_count - this->allocations;
+    //! recording allocates; a destructor must not throw, so a sample
+    //! that cannot be recorded is dropped
+    try {
+        Context::current().profile.add(this->name, stat);
+        std::lock_guard<std::mutex> lock(global_mutex);
+        global_profile().add(this->name, stat);
+    } catch (...) {
+    }
+}
+
+} // end of namespace markdown
+
+#endif // USE_PROFILING
@@ -0,0 +1,130 @@
+/*
+ * Profiler.h
+ *
+ *  Created on: 2026/10/17
+ *      Author: mugwort_rc
+ */
+
+#ifndef PROFILER_H_
+#define PROFILER_H_
+
+/*!
+ * Per-stage instrumentation of the conversion pipeline.
+ *
+ * Build with USE_PROFILING defined to record, for every stage of
+ * Markdown::convert() and every registered pre-, tree- and postprocessor
+ * (named by its OrderedDict key, e.g. "preprocessors.html_block"), the
+ * number of calls, the wall time and the memory allocated through
+ * operator new while it ran. Times and allocations are inclusive: the
+ * "convert" stage contains all the others.
+ *
+ * The numbers are collected in the Context of the conversion and in a
+ * process-wide Profile:
+ *
+ *     markdown::Context context;
+ *     md.convert(context, source, html);
+ *     std::cout << context.profile.toJSON();
+ *     std::cout << markdown::Profile::global().toJSON();
+ *
+ * Without USE_PROFILING, MARKDOWN_PROFILE() expands to nothing and none
+ * of this is compiled.
+ *
+ * To count allocations, a profiling build replaces the global operator
+ * new and operator delete of the whole process, the application linking
+ * the library included: the plain, array, nothrow, sized and (with C++17)
+ * aligned forms, all on top of malloc() and free(). An application that
+ * replaces them itself cannot be linked with a profiling build.
+ */
+
+#ifdef USE_PROFILING
+
+#include <cstddef>
+#include <map>
+#include <string>
+
+#include <chrono>
+
+#include <boost/cstdint.hpp>
+#include <boost/preprocessor/cat.hpp>
+
+namespace markdown{
+
+class Profile
+{
+public:
+    struct Stat
+    {
+        Stat(void) :
+            calls(0), nanoseconds(0), bytes(0), allocations(0)
+        {}
+
+        std::size_t     calls;
+        boost::uint64_t nanoseconds;
+        std::size_t     bytes;        //!< requested from operator new
+        std::size_t     allocations;  //!< calls to operator new
+    };
+    typedef std::map<std::string, Stat> Stats;
+
+public:
+    void add(const std::string& name, const Stat& stat);
+    void merge(const Profile& other);
+    void clear(void);
+
+    const Stats& stats(void) const
+    { return this->_stats; }
+
+    /*!
+     * {"stage": {"calls": n, "nanoseconds": n, "bytes": n, "allocations": n}, ...}
+     */
+    std::string toJSON(void) const;
+
+    /*!
+     * Snapshot of every conversion in the process so far.
+     */
+    static Profile global(void);
+    static void resetGlobal(void);
+
+    /*!
+     * Totals of operator new on the calling thread.
+     */
+    static std::size_t allocatedBytes(void);
+    static std::size_t allocationCount(void);
+
+    /*!
+     * Time a stage until the end of the scope and record it in the
+     * current Context and the global profile.
+     */
+    class Scope
+    {
+    public:
+        Scope(const std::string& name);
+        ~Scope(void);
+
+    private:
+        Scope(const Scope&);
+        Scope& operator =(const Scope&);
+
+    private:
+        std::string name;
+        std::chrono::steady_clock::time_point start;
+        std::size_t bytes;
+        std::size_t allocations;
+
+    };
+
+private:
+    Stats _stats;
+
+};
+
+} // end of namespace markdown
+
+#define MARKDOWN_PROFILE(name) ::markdown::Profile::Scope BOOST_PP_CAT(markdown_profile_, __LINE__)(name)
+
+#else
+
+#define MARKDOWN_PROFILE(name)
+
+#endif // USE_PROFILING
+
+#endif // PROFILER_H_
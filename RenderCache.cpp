@@ -0,0 +1,155 @@
+/*
+ * RenderCache.cpp
+ *
+ *  Created on: 2026/10/17
+ *      Author: mugwort_rc
+ */
+
+#include "RenderCache.h"
+
+#include <functional>
+#include <typeinfo>
+#include <utility>
+
+#include <boost/functional/hash.hpp>
+
+#include "MarkdownCpp.h"
+
+namespace markdown{
+
+RenderCache::RenderCache(std::size_t capacity) :
+    _capacity(capacity),
+    mutex(), entries(), index(),
+    _hits(0), _misses(0), _evictions(0)
+{}
+
+std::wstring RenderCache::convert(const Markdown& md, const std::wstring& source)
+{
+    std::wstring output;
+    this->convert(md, source, output);
+    return output;
+}
+
+void RenderCache::convert(const Markdown& md, const std::wstring& source, std::wstring& output)
+{
+    const Configuration config = RenderCache::configuration(md);
+    std::size_t key = std::hash<std::wstring>()(source);
+    boost::hash_combine(key, config.hash());
+
+    Html html = this->find(key, config, source);
+    if ( html ) {
+        ++this->_hits;
+        output.assign(*html);
+        return;
+    }
+    ++this->_misses;
+    md.convert(source, output);
+    if ( this->_capacity > 0 ) {
+        this->store(key, config, source, Html(new std::wstring(output)));
+    }
+}
+
+std::size_t RenderCache::size(void) const
+{
+    std::lock_guard<std::mutex> lock(this->mutex);
+    return this->entries.size();
+}
+
+void RenderCache::clear(void)
+{
+    std::lock_guard<std::mutex> lock(this->mutex);
+    this->index.clear();
+    this->entries.clear();
+}
+
+std::size_t RenderCache::fingerprint(const Markdown& md)
+{
+    return RenderCache::configuration(md).hash();
+}
+
+bool RenderCache::Configuration::operator ==(const Configuration& rhs) const
+{
+    return this->output_format == rhs.output_format &&
+           this->safe_mode == rhs.safe_mode &&
+           this->html_replacement_text == rhs.html_replacement_text &&
+           this->tab_length == rhs.tab_length &&
+           this->enable_attributes == rhs.enable_attributes &&
+           this->smart_emphasis == rhs.smart_emphasis &&
+           this->lazy_ol == rhs.lazy_ol &&
+           this->doc_tag == rhs.doc_tag &&
+           this->extensions == rhs.extensions;
+}
+
+std::size_t RenderCache::Configuration::hash(void) const
+{
+    std::size_t seed = 0;
+    boost::hash_combine(seed, this->output_format);
+    boost::hash_combine(seed, this->safe_mode);
+    boost::hash_combine(seed, this->html_replacement_text);
+    boost::hash_combine(seed, this->tab_length);
+    boost::hash_combine(seed, this->enable_attributes);
+    boost::hash_combine(seed, this->smart_emphasis);
+    boost::hash_combine(seed, this->lazy_ol);
+    boost::hash_combine(seed, this->doc_tag);
+    for ( const auto& ext : this->extensions ) {
+        boost::hash_combine(seed, ext.first);
+        for ( const Extension::Config::value_type& item : ext.second ) {
+            boost::hash_combine(seed, item.first);
+            boost::hash_range(seed, item.second.begin(), item.second.end());
+        }
+    }
+    return seed;
+}
+
+RenderCache::Configuration RenderCache::configuration(const Markdown& md)
+{
+    Configuration config;
+    config.output_format = static_cast<int>(md.output_format());
+    config.safe_mode = static_cast<int>(md.safeMode());
+    config.html_replacement_text = md.html_replacement_text();
+    config.tab_length = md.tab_length();
+    config.enable_attributes = md.enable_attributes();
+    config.smart_emphasis = md.smart_emphasis();
+    config.lazy_ol = md.lazy_ol();
+    config.doc_tag = md.doc_tag();
+    for ( const Extension::Ptr& ext : md.registeredExtensions() ) {
+        config.extensions.push_back(std::make_pair(std::string(typeid(*ext).name()), ext->getConfigs()));
+    }
+    return config;
+}
+
+RenderCache::Html RenderCache::find(std::size_t key, const Configuration& config, const std::wstring& source)
+{
+    std::lock_guard<std::mutex> lock(this->mutex);
+    auto it = this->index.find(key);
+    if ( it == this->index.end() ) {
+        return Html();
+    }
+    Entries::iterator entry = it->second;
+    if ( entry->config != config || entry->source != source ) {
+        return Html();  //!< hash collision
+    }
+    this->entries.splice(this->entries.begin(), this->entries, entry);
+    return entry->html;
+}
+
+void RenderCache::store(std::size_t key, const Configuration& config, const std::wstring& source, const Html& html)
+{
+    std::lock_guard<std::mutex> lock(this->mutex);
+    auto it = this->index.find(key);
+    if ( it != this->index.end() ) {
+        //! converted by another thread meanwhile, or a collision: keep the newest
+        this->entries.erase(it->second);
+        this->index.erase(it);
+    }
+    Entry entry = {key, config, source, html};
+    this->entries.push_front(entry);
+    this->index[key] = this->entries.begin();
+    while ( this->entries.size() > this->_capacity ) {
+        this->index.erase(this->entries.back().key);
+        this->entries.pop_back();
+        ++this->_evictions;
+    }
+}
+
+} // end of namespace markdown
@@ -0,0 +1,141 @@
+/*
+ * RenderCache.h
+ *
+ *  Created on: 2026/10/17
+ *      Author: mugwort_rc
+ */
+
+#ifndef RENDERCACHE_H_
+#define RENDERCACHE_H_
+
+#include <atomic>
+#include <cstddef>
+#include <list>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <boost/shared_ptr.hpp>
+
+#include "extensions/Extension.h"
+
+namespace markdown{
+
+class Markdown;  //!< forward declaration
+
+/*!
+ * Bounded LRU cache of rendered documents in front of Markdown::convert.
+ *
+ * Entries are keyed by a hash of the source and a fingerprint of the
+ * Markdown configuration (output format, safe mode, tab length, the
+ * boolean options, the document tag and the registered extensions with
+ * their configs), so one cache can serve several Markdown instances. The
+ * source and the configuration are kept with each entry and compared on
+ * lookup, so a hash collision is a miss, never a wrong page.
+ *
+ * Processors added to a Markdown by hand rather than through an
+ * Extension are not part of the fingerprint; give such instances a cache
+ * of their own.
+ *
+ * A RenderCache is safe to share between threads. Conversions run
+ * outside its lock, so two threads missing on the same document may both
+ * convert it.
+ *
+ */
+class RenderCache
+{
+public:
+    /*!
+     * Keyword arguments:
+     *
+     * * capacity: Maximum number of documents kept.
+     */
+    RenderCache(std::size_t capacity=1024);
+
+    /*!
+     * Return the html of `source` converted by `md`, converting and
+     * storing it on a miss.
+     */
+    std::wstring convert(const Markdown& md, const std::wstring& source);
+    void convert(const Markdown& md, const std::wstring& source, std::wstring& output);
+
+    std::size_t hits(void) const
+    { return this->_hits; }
+    std::size_t misses(void) const
+    { return this->_misses; }
+    std::size_t evictions(void) const
+    { return this->_evictions; }
+    std::size_t capacity(void) const
+    { return this->_capacity; }
+    std::size_t size(void) const;
+
+    /*!
+     * Drop every entry. The counters are kept.
+     */
+    void clear(void);
+
+    /*!
+     * Hash of the configuration of `md` that affects its output.
+     */
+    static std::size_t fingerprint(const Markdown& md);
+
+private:
+    typedef boost::shared_ptr<const std::wstring> Html;
+
+    /*!
+     * The configuration of a Markdown that affects its output.
+     */
+    struct Configuration
+    {
+        int          output_format;
+        int          safe_mode;
+        std::wstring html_replacement_text;
+        int          tab_length;
+        bool         enable_attributes;
+        bool         smart_emphasis;
+        bool         lazy_ol;
+        std::wstring doc_tag;
+        std::vector<std::pair<std::string, Extension::Config>> extensions;  //!< type name and configs
+
+        bool operator ==(const Configuration& rhs) const;
+        bool operator !=(const Configuration& rhs) const
+        { return !(*this == rhs); }
+        std::size_t hash(void) const;
+    };
+
+    struct Entry
+    {
+        std::size_t   key;
+        Configuration config;
+        std::wstring  source;
+        Html          html;
+    };
+    typedef std::list<Entry> Entries;
+
+    static Configuration configuration(const Markdown& md);
+
+    Html find(std::size_t key, const Configuration& config, const std::wstring& source);
+    void store(std::size_t key, const Configuration& config, const std::wstring& source, const Html& html);
+
+private:
+    RenderCache(const RenderCache&);
+    RenderCache& operator =(const RenderCache&);
+
+private:
+    const std::size_t _capacity;
+
+    mutable std::mutex mutex;
+    Entries entries;  //!< most recently used first
+    std::unordered_map<std::size_t, Entries::iterator> index;
+
+    std::atomic<std::size_t> _hits;
+    std::atomic<std::size_t> _misses;
+    std::atomic<std::size_t> _evictions;
+
+};
+
+} // end of namespace markdown
+
+#endif // RENDERCACHE_H_
@@ -8,7 +8,6 @@
 #include "Serializers.h"
 
 #include <functional>
-#include <set>
 #include <utility>
 
 #include <boost/algorithm/string.hpp>
@@ -25,19 +24,6 @@ typedef enum {
 
 typedef std::map<std::wstring, std::wstring> NamespaceMap;
 
-template<typename T, typename V>
-std::list<T> keys(const std::map<T,V>& src)
-{
-    std::list<T> result;
-    for ( auto it = src.begin(); it != src.end(); ++it ) {
-        result.push_back(it->first);
-    }
-    return result;
-}
-
-static const std::set<std::wstring> HTML_EMPTY = {L"area", L"base", L"basefont", L"br", L"col", L"frame", L"hr",
-                                                  L"img", L"input", L"isindex", L"link", L"meta", L"param"};
-
 static const NamespaceMap namespace_map = {
     // "well-known" namespace prefixes
     std::make_pair(L"http://www.w3.org/XML/1998/namespace", L"xml"),
@@ -93,27 +79,29 @@ std::wstring escape_attrib(const std::wstring& text)
     return result;
 }
 
-std::wstring escape_attrib_html(const std::wstring& text)
+void append_attrib_html(std::wstring& output, boost::wstring_view text)
 {
-    //! escape attribute value
-    std::wstring result = text;
-    if ( result.find(L'&') != std::wstring::npos ) {
-        boost::algorithm::replace_all(result, L"&", L"&amp;");
-    }
-    if ( result.find(L'<') != std::wstring::npos ) {
-        boost::algorithm::replace_all(result, L"<", L"&lt;");
-    }
-    if ( result.find(L'>') != std::wstring::npos ) {
-        boost::algorithm::replace_all(result, L">", L"&gt;");
-    }
-    if ( result.find(L'"') != std::wstring::npos ) {
-        boost::algorithm::replace_all(result, L"\"", L"&quot;");
+    //! escape attribute value straight into the output
+    std::size_t begin = 0;
+    for ( std::size_t i = 0; i < text.size(); ++i ) {
+        const wchar_t* entity;
+        switch ( text[i] ) {
+        case L'&': entity = L"&amp;";  break;
+        case L'<': entity = L"&lt;";   break;
+        case L'>': entity = L"&gt;";   break;
+        case L'"': entity = L"&quot;"; break;
+        default: continue;
+        }
+        output.append(text.data() + begin, i - begin);
+        output.append(entity);
+        begin = i + 1;
     }
-    return result;
+    output.append(text.data() + begin, text.size() - begin);
 }
 
-void serialize_html(const std::function<void(const std::wstring&)>& write, Element& elem, const NamespaceMap& qnames, const NamespaceMap& namespaces, Format format)
+void serialize_html(std::wstring& output, Element& elem, const NamespaceMap& qnames, const NamespaceMap& namespaces, Format format)
 {
+    auto write = [&output](const std::wstring& text){ output.append(text); };
     /*
     if ( elem->getNodeType() == xercesc::DOMNode::COMMENT_NODE ) {
         xercesc::DOMComment* comment = reinterpret_cast<xercesc::DOMComment*>(elem);
@@ -123,19 +111,28 @@ void serialize_html(const std::function<void(const std::wstring&)>& write, Eleme
         write((boost::wformat(L"<?%s %s?>")%escape_cdata(wconvert(pi->getTarget()))%escape_cdata(wconvert(pi->getData()))).str());
     } else */{
         std::wstring tag = elem.getTagName();
+        const HtmlTag::Atom atom = elem.getTag();
         write(L"<"+tag);
-        Element::Attributes attrs = elem.getAttributes();
-        if ( attrs.size() > 0 ) {
-            std::list<std::wstring> attrKeys = keys(attrs);
-            attrKeys.sort();  //!< lexical order
-            for ( const std::wstring& key : attrKeys ) {
-                const std::wstring value = escape_attrib_html(attrs[key]);
-                if ( format == html && qnames.find(key) != qnames.end() && qnames.at(key) == value ) {
+        if ( elem.attributeCount() > 0 ) {
+            for ( const Attribute attr : elem.attributes() ) {  //!< lexical order
+                boost::wstring_view qname = attr.name;
+                if ( ! qname.empty() && qname.front() == L'{' ) {
+                    NamespaceMap::const_iterator it = qnames.find(std::wstring(qname.data(), qname.size()));
+                    if ( it == qnames.end() ) {
+                        continue;
+                    }
+                    qname = it->second;
+                }
+                output.push_back(L' ');
+                if ( format == html && attr.value == qname ) {
                     //! handle boolean attributes
-                    write((boost::wformat(L" %s")%value).str());
-                } else if ( qnames.find(key) != qnames.end() ) {
-                    write((boost::wformat(L" %s=\"%s\"")%qnames.at(key)%value).str());
+                    append_attrib_html(output, attr.value);
+                    continue;
                 }
+                output.append(qname.data(), qname.size());
+                output.append(L"=\"");
+                append_attrib_html(output, attr.value);
+                output.push_back(L'"');
             }
             if ( ! namespaces.empty() ) {
                 typedef std::pair<std::wstring, std::wstring> Pair;
@@ -154,22 +151,22 @@ void serialize_html(const std::function<void(const std::wstring&)>& write, Eleme
                 }
             }
         }
-        if ( format == xhtml && HTML_EMPTY.find(tag) != HTML_EMPTY.end() ) {
+        if ( format == xhtml && HtmlTag::isEmpty(atom) ) {
             write(L"/>");
         } else {
             write(L">");
             std::transform(tag.begin(), tag.end(), tag.begin(), ::tolower);
             if ( elem.hasText() ) {
-                if ( tag == L"script" || tag == L"style" ) {
+                if ( HtmlTag::isRawText(atom) ) {
                     write(elem.text());
                 } else {
                     write(escape_cdata(elem.text()));
                 }
             }
-            for ( Element& child : elem.child() ) {
-                serialize_html(write, child, qnames, NamespaceMap(), format);
+            for ( Element child : elem.children() ) {
+                serialize_html(output, child, qnames, NamespaceMap(), format);
             }
-            if ( HTML_EMPTY.find(tag) == HTML_EMPTY.end() ) {
+            if ( ! HtmlTag::isEmpty(atom) ) {
                 write((boost::wformat(L"</%s>")%tag).str());
             }
         }
@@ -224,8 +221,8 @@ boost::tuples::tuple<NamespaceMap, NamespaceMap> namespaces(Element &elem, const
     //! populate qname and namespaces table
     std::list<Element> iterNodes;
     std::function<void(const Element&)> iter = [&](const Element &it){
-        if ( it.child().size() > 0 ) {
-            for ( const Element& node : it.child() ) {
+        if ( it.hasChildren() ) {
+            for ( const Element node : it.children() ) {
                 iterNodes.push_back(node);
                 iter(node);
             }
@@ -243,10 +240,14 @@ boost::tuples::tuple<NamespaceMap, NamespaceMap> namespaces(Element &elem, const
             if ( qnames.find(tag) != qnames.end() ) {
                 add_qname(tag);
             }
-            Element::Attributes attrs = node.getAttributes();
-            for ( const std::wstring& key : keys(attrs) ) {
-                if ( qnames.find(key) == qnames.end() ) {
-                    add_qname(key);
+            //! unqualified attribute names are their own qname and are
+            //! written as they are
+            for ( const Attribute attr : node.attributes() ) {
+                if ( ! attr.name.empty() && attr.name.front() == L'{' ) {
+                    const std::wstring key(attr.name.data(), attr.name.size());
+                    if ( qnames.find(key) == qnames.end() ) {
+                        add_qname(key);
+                    }
                 }
             }
         }
@@ -254,28 +255,40 @@ boost::tuples::tuple<NamespaceMap, NamespaceMap> namespaces(Element &elem, const
     return boost::tuples::make_tuple(qnames, nss);
 }
 
-std::wstring write_html(Element &root, const Format& format)
+void write_html(Element &root, const Format& format, std::wstring& output)
 {
     if ( root.isNull() ) {
-        return std::wstring();
+        return;
     }
-    std::list<std::wstring> data;
     NamespaceMap qnames, namespaces_map;
     boost::tuples::tuple<NamespaceMap, NamespaceMap> result = namespaces(root);
     qnames = result.get<0>();
     namespaces_map = result.get<1>();
-    serialize_html([&](const std::wstring& text){ data.push_back(text); }, root, qnames, namespaces_map, format);
-    return boost::algorithm::join(data, std::wstring());
+    serialize_html(output, root, qnames, namespaces_map, format);
 }
 
 std::wstring to_html_string(Element &element)
 {
-    return write_html(element, html);
+    std::wstring output;
+    write_html(element, html, output);
+    return output;
 }
 
 std::wstring to_xhtml_string(Element &element)
 {
-    return write_html(element, xhtml);
+    std::wstring output;
+    write_html(element, xhtml, output);
+    return output;
+}
+
+void write_html_string(Element& element, std::wstring& output)
+{
+    write_html(element, html, output);
+}
+
+void write_xhtml_string(Element& element, std::wstring& output)
+{
+    write_html(element, xhtml, output);
 }
 
 } // end of namespace markdown
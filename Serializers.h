@@ -16,6 +16,14 @@ std::wstring to_html_string(Element& element);
 
 std::wstring to_xhtml_string(Element& element);
 
+/*!
+ * Serialize `element` by appending to `output`, so a caller can reuse one
+ * buffer across documents instead of receiving a fresh string each time.
+ */
+void write_html_string(Element& element, std::wstring& output);
+
+void write_xhtml_string(Element& element, std::wstring& output);
+
 } // end of namespace markdown
 
 #endif // SERIALIZERS_H_
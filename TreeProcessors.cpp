@@ -7,25 +7,199 @@
 
 #include "TreeProcessors.h"
 
+#include <algorithm>
+#include <iostream>
 #include <utility>
+#include <vector>
 
 #include <boost/algorithm/string.hpp>
-#include <boost/format.hpp>
 
 #include "MarkdownCpp.h"
+#include "Context.h"
+#include "Unicode.h"
 
 namespace markdown{
 
-template<typename T>
-void append(std::list<T>& dest, const std::list<T> &src)
+template<typename T, typename Range>
+void append(std::list<T>& dest, const Range &src)
 {
-    for ( const T& v : src ) {
+    for ( const T v : src ) {
         dest.push_back(v);
     }
 }
 
+namespace {
+
+/*!
+ * Text rewritten by one inline pattern in a single pass.
+ *
+ * The result up to the cursor is in `done`; the text from the cursor on
+ * is at the end of `buffer`, whose front is free, so that a placeholder
+ * and whatever must be searched again can be pushed back in front of the
+ * cursor without copying the rest. The character before the cursor is
+ * kept in front of it, where one-character look-behinds and '^' see it.
+ *
+ * A match that handleMatch() turns down is left as text, and the search
+ * goes on after it as if the text began there: the original engine
+ * matched the rest of the text alone.
+ */
+class InlineScan
+{
+public:
+    explicit InlineScan(const std::wstring& data) :
+        buffer(ROOM + data.size(), L'\0'), cursor(ROOM), scanned(0)
+    {
+        std::copy(data.begin(), data.end(), this->buffer.begin() + ROOM);
+    }
+
+    bool search(const Pattern& pattern, boost::wsmatch& match)
+    {
+        std::wstring::const_iterator first = this->buffer.cbegin() + this->cursor;
+        if ( this->done.size() > this->origin() ) {
+            this->buffer[this->cursor-1] = this->done.back();
+            return pattern.search(first-1, first, this->buffer.cend(), match, boost::match_prev_avail);
+        }
+        return pattern.search(first, first, this->buffer.cend(), match, boost::match_default);
+    }
+
+    //! Keep the match as text.
+    void keep(const boost::wsmatch& match)
+    {
+        std::size_t start = match[0].first - this->buffer.cbegin();
+        std::size_t end = match[0].second - this->buffer.cbegin();
+        this->done.append(this->buffer, this->cursor, end-this->cursor);
+        this->kept.push_back(std::make_pair(this->done.size()-(end-start), this->done.size()));
+        this->cursor = end;
+    }
+
+    //! Replace the match by `placeholder`.
+    void replace(const boost::wsmatch& match, const std::wstring& placeholder, Pattern::Rescan rescan)
+    {
+        std::size_t start = match[0].first - this->buffer.cbegin();
+        std::size_t end = match[0].second - this->buffer.cbegin();
+        this->done.append(this->buffer, this->cursor, start-this->cursor);
+        std::size_t from = this->done.size();
+        switch ( rescan ) {
+        case Pattern::rescan_all:
+            from = 0;
+            break;
+        case Pattern::rescan_none:
+            this->done += placeholder;
+            this->cursor = end;
+            return;
+        case Pattern::rescan_adjacent:
+            if ( from > 0 && this->done[from-1] == *match[0].first ) {
+                --from;
+            }
+            break;
+        case Pattern::rescan_closing:
+            if ( from > 0 && this->done[from-1] == *match[0].first ) {
+                from = this->done.find(*match[0].first);
+            }
+            break;
+        case Pattern::rescan_brackets:
+            from = this->openBracket();
+            break;
+        }
+        //! the original engine searched the whole text again, finding the
+        //! matches it had kept as text before `from` once more
+        while ( ! this->kept.empty() && this->kept.back().second > from ) {
+            if ( this->kept.back().first < from ) {
+                from = this->kept.back().first;
+                this->scanned = 0;  //!< the brackets open there are not known
+            }
+            this->kept.pop_back();
+        }
+        this->scanned = std::min(this->scanned, from);
+        while ( ! this->groups.empty() && this->groups.back().second >= from ) {
+            this->groups.pop_back();
+        }
+
+        //! push the text from `from` back in front of the rest
+        std::wstring text = this->done.substr(from) + placeholder;
+        this->done.resize(from);
+        if ( end > text.size() ) {
+            this->cursor = end - text.size();
+            std::copy(text.begin(), text.end(), this->buffer.begin() + this->cursor);
+        } else {
+            text.append(this->buffer, end, std::wstring::npos);
+            this->buffer.assign(ROOM, L'\0');
+            this->buffer += text;
+            this->cursor = ROOM;
+        }
+    }
+
+    std::wstring result(void)
+    {
+        this->done.append(this->buffer, this->cursor, std::wstring::npos);
+        return this->done;
+    }
+
+private:
+    //! where the text searched begins, in `done`
+    std::size_t origin(void) const
+    { return this->kept.empty() ? 0 : this->kept.back().second; }
+
+    /*!
+     * The earliest '[' of `done` still open at its end, with the "[...]"
+     * before it when it opens a reference id and the '!' before it for
+     * images; the end of `done` if there is none.
+     *
+     * Only such a bracket can start a match that reaches the placeholder
+     * about to be appended. The open brackets are counted once over the
+     * text, and again only over text pushed back.
+     */
+    std::size_t openBracket(void)
+    {
+        if ( this->scanned == 0 ) {
+            this->open.clear();
+            this->groups.clear();
+        }
+        for ( ; this->scanned < this->done.size(); ++this->scanned ) {
+            if ( this->done[this->scanned] == L'[' ) {
+                this->open.push_back(this->scanned);
+            } else if ( this->done[this->scanned] == L']' && ! this->open.empty() ) {
+                if ( this->open.size() == 1 ) {
+                    this->groups.push_back(std::make_pair(this->open.back(), this->scanned));
+                }
+                this->open.pop_back();
+            }
+        }
+        if ( this->open.empty() ) {
+            return this->done.size();
+        }
+        std::size_t from = this->open.front();
+        if ( ! this->groups.empty() ) {
+            std::size_t close = this->groups.back().second;
+            if ( close+1 == from || ( close+2 == from && this->done[close+1] == L' ' ) ) {
+                from = this->groups.back().first;
+            }
+        }
+        if ( from > 0 && this->done[from-1] == L'!' ) {
+            --from;
+        }
+        //! everything before `from` is closed
+        this->open.clear();
+        return from;
+    }
+
+private:
+    static const std::size_t ROOM = 32;  //!< free space in front of the text at first
+
+    std::wstring done;
+    std::wstring buffer;
+    std::size_t cursor;                                        //!< position of the rest in `buffer`
+    std::vector<std::pair<std::size_t, std::size_t> > kept;    //!< matches kept as text, in `done`
+    std::size_t scanned;                                       //!< `done` is counted for brackets up to here
+    std::vector<std::size_t> open;                             //!< open '[' of `done`
+    std::vector<std::pair<std::size_t, std::size_t> > groups;  //!< outermost "[...]" of `done`
+
+};
+
+} // end of anonymous namespace
+
 TreeProcessor::TreeProcessor(Markdown* md_instance) :
-    markdown(md_instance), stashed_nodes()
+    markdown(md_instance)
 {}
 
 TreeProcessor::~TreeProcessor(void)
@@ -40,11 +214,14 @@ public:
     InlineProcessor(Markdown* md) :
         TreeProcessor(md),
         placeholder_prefix(util::INLINE_PLACEHOLDER_PREFIX),
-        placeholder_suffix(util::ETX),
-        placeholder_length(4 + this->placeholder_prefix.size() + this->placeholder_suffix.size()),
-        placeholder_re(util::INLINE_PLACEHOLDER_RE),
-        class_root(ElementTree::InvalidElementTree)
-    {}
+        placeholder_suffix(util::ETX)
+    {
+        for ( wchar_t ch : this->placeholder_prefix + this->placeholder_suffix + L"0123456789" ) {
+            if ( static_cast<unsigned long>(ch) < this->placeholder_chars.size() ) {
+                this->placeholder_chars.set(ch);
+            }
+        }
+    }
 
     ~InlineProcessor(void)
     {}
@@ -53,11 +230,9 @@ private:
     /*!
      * Generate a placeholder
      */
-    boost::tuples::tuple<std::wstring, std::wstring> makePlaceholder(const std::wstring&/* type*/)
+    std::wstring makePlaceholder(const std::wstring&/* type*/)
     {
-        std::wstring id = (boost::wformat(L"%04d")%this->stashed_nodes.size()).str();
-        std::wstring hash = (boost::wformat(util::INLINE_PLACEHOLDER)%id).str();
-        return boost::tuples::make_tuple(hash, id);
+        return util::inlinePlaceholder(Context::current().stashed_nodes.size());
     }
 
     /*!
@@ -71,15 +246,14 @@ private:
      * Returns: placeholder id and string index, after the found placeholder.
      *
      */
-    boost::tuples::tuple<boost::optional<std::wstring>, int> findPlaceholder(const std::wstring& data, std::wstring::size_type index)
+    boost::tuples::tuple<boost::optional<std::size_t>, std::size_t> findPlaceholder(const std::wstring& data, std::wstring::size_type index)
     {
-        std::wstring regexTmp = data;
-        if ( index != std::wstring::npos ) {
-            regexTmp = data.substr(index, data.size()-index);
+        if ( index == std::wstring::npos ) {
+            index = 0;
         }
-        boost::wsmatch m;
-        if ( boost::regex_search(regexTmp, m, this->placeholder_re) ) {
-            return boost::tuples::make_tuple(m.str(1), index+m.position()+m.length());
+        std::size_t id, end;
+        if ( util::parseInlinePlaceholder(data, index, id, end) ) {
+            return boost::tuples::make_tuple(id, end);
         } else {
             return boost::tuples::make_tuple(boost::none, index+1);
         }
@@ -90,20 +264,14 @@ private:
      */
     std::wstring stashNode(Element &node, const std::wstring& type)
     {
-        std::wstring placeholder, id;
-        boost::tuples::tuple<std::wstring, std::wstring> result = this->makePlaceholder(type);
-        placeholder = result.get<0>();
-        id = result.get<1>();
-        this->stashed_nodes[id] = boost::tuples::make_tuple(boost::none, node);
+        std::wstring placeholder = this->makePlaceholder(type);
+        Context::current().stashed_nodes.push_back(boost::tuples::make_tuple(boost::none, node));
         return placeholder;
     }
     std::wstring stashNode(const std::wstring& node, const std::wstring& type)
     {
-        std::wstring placeholder, id;
-        boost::tuples::tuple<std::wstring, std::wstring> result = this->makePlaceholder(type);
-        placeholder = result.get<0>();
-        id = result.get<1>();
-        this->stashed_nodes[id] = boost::tuples::make_tuple(node, boost::none);
+        std::wstring placeholder = this->makePlaceholder(type);
+        Context::current().stashed_nodes.push_back(boost::tuples::make_tuple(node, boost::none));
         return placeholder;
     }
 
@@ -121,16 +289,25 @@ private:
      */
     std::wstring handleInline(const std::wstring& data, std::size_t patternIndex = 0)
     {
-        int startIndex = 0;
+        BudgetMeter::Nesting nesting(Context::current().meter);
+        const OrderedDictPatterns& patterns = this->markdown->inlinePatterns;
+        Pattern::Triggers wanted;
+        for ( std::size_t i = patternIndex; i < patterns.size(); ++i ) {
+            wanted |= patterns.at(i)->triggers();
+        }
+        //! replacements only take characters away, apart from those of
+        //! the placeholders, so the set found here stays a superset
+        Pattern::Triggers present = ascii_present(data.data(), data.size(), wanted);
         std::wstring data_ = data;
-        while ( patternIndex < this->markdown->inlinePatterns.size() ) {
-            boost::shared_ptr<Pattern> pattern = this->markdown->inlinePatterns.at(patternIndex);
-            boost::tuples::tuple<std::wstring, bool, int> result = this->applyPattern(pattern, data_, patternIndex, startIndex);
-            data_ = result.get<0>();
-            bool matched = result.get<1>();
-            startIndex = result.get<2>();
-            if ( ! matched ) {
-                patternIndex += 1;
+        for ( ; patternIndex < patterns.size(); ++patternIndex ) {
+            boost::shared_ptr<Pattern> pattern = patterns.at(patternIndex);
+            if ( pattern->triggers().any() && ( pattern->triggers() & present ).none() ) {
+                continue;
+            }
+            std::size_t stashed = Context::current().stashed_nodes.size();
+            data_ = this->applyPattern(pattern, data_, patternIndex);
+            if ( Context::current().stashed_nodes.size() != stashed ) {
+                present |= this->placeholder_chars;
             }
         }
         return data_;
@@ -182,7 +359,7 @@ private:
                 node.insertBefore(newChild, pos);
                 pos = newChild;
             } else {
-                if ( node.child().size() > 0 ) {
+                if ( node.hasChildren() ) {
                     node.insertBefore(newChild, node.getFirstElementChild());
                 } else {
                     node.append(newChild);
@@ -225,16 +402,16 @@ private:
                 }
             }
         };
-        int startIndex = 0;
+        std::wstring::size_type startIndex = 0;
         std::wstring data_ = data;
         while ( ! data_.empty() ) {
             std::wstring::size_type index = data_.find(this->placeholder_prefix, startIndex);
             if ( index != std::wstring::npos ) {
-                boost::tuples::tuple<boost::optional<std::wstring>, int> ret = this->findPlaceholder(data_, index);
-                boost::optional<std::wstring> id = ret.get<0>();
-                int phEndIndex = ret.get<1>();
-                if ( this->stashed_nodes.find(*id) != this->stashed_nodes.end() ) {
-                    NodeItem node = this->stashed_nodes[*id];
+                boost::tuples::tuple<boost::optional<std::size_t>, std::size_t> ret = this->findPlaceholder(data_, index);
+                boost::optional<std::size_t> id = ret.get<0>();
+                std::size_t phEndIndex = ret.get<1>();
+                if ( id && *id < Context::current().stashed_nodes.size() ) {
+                    NodeItem node = Context::current().stashed_nodes[*id];
                     boost::optional<std::wstring> str = node.get<0>();
                     boost::optional<Element> nodeptr = node.get<1>();
                     if ( index > 0 ) {
@@ -245,7 +422,7 @@ private:
                     if ( ! str ) {
                         //! it's Element
                         Element::List nodes = {*nodeptr};
-                        for ( Element &e : (*nodeptr).child() ) {
+                        for ( Element e : (*nodeptr).children() ) {
                             nodes.push_back(e);
                         }
                         for ( Element &child : nodes ) {
@@ -273,7 +450,7 @@ private:
 
                 } else {
                     //! wrong placeholder
-                    int end = index + this->placeholder_prefix.size();
+                    std::wstring::size_type end = index + this->placeholder_prefix.size();
                     linkText(data_.substr(startIndex, end-startIndex));
                     startIndex = end;
                 }
@@ -287,59 +464,67 @@ private:
     }
 
     /*!
-     * Check if the line fits the pattern, create the necessary
-     * elements, add it to stashed_nodes.
+     * Replace every match of the pattern in the line, create the necessary
+     * elements, add them to stashed_nodes.
+     *
+     * The line is searched once from left to right: after a replacement
+     * the search resumes as told by Pattern::rescan(), which finds the
+     * matches the original engine found by matching the whole line again
+     * after each replacement.
      *
      * Keyword arguments:
      *
-     * * data: the text to be processed
      * * pattern: the pattern to be checked
+     * * data: the text to be processed
      * * patternIndex: index of current pattern
-     * * startIndex: string index, from which we start searching
      *
      * Returns: String with placeholders instead of ElementTree elements.
      *
      */
-    boost::tuples::tuple<std::wstring, bool, int> applyPattern(boost::shared_ptr<Pattern> pattern, const std::wstring& data, int patternIndex, int startIndex=0)
+    std::wstring applyPattern(boost::shared_ptr<Pattern> pattern, const std::wstring& data, std::size_t patternIndex)
     {
-        std::wstring regexTmp = data.substr(startIndex, data.size()-startIndex);
+        BudgetMeter& meter = Context::current().meter;
+        InlineScan scan(data);
         boost::wsmatch match;
-        if ( ! boost::regex_match(regexTmp, match, pattern->getCompiledRegExp()) ) {
-            return boost::tuples::make_tuple(data, false, 0);
-        }
-        std::wstring leftData = data.substr(0, startIndex);
-
-        boost::optional<std::wstring> result = pattern->handleMatch(match);  //!< first handleMatch (case String)
-        std::wstring placeholder;
-        if ( ! result ) {
-            Element node = pattern->handleMatch(this->class_root, match);     //!< second handleMatch (case Node)
-            if ( node.isNull() ) {
-                return boost::tuples::make_tuple(data, true, leftData.size()+match.position(match.size()-1));
+        while ( true ) {
+            meter.step();
+            if ( ! scan.search(*pattern, match) ) {
+                break;
             }
-            if ( node.child().size() == 0 || node.hasText() ) {
-                //! We need to process current node too
-                Element::List nodes = {node};
-                append(nodes, node.child());
-                for ( Element& child : nodes ) {
-                    if ( child.hasText() ) {
-                        std::wstring text = child.text();
-                        text = this->handleInline(text, patternIndex+1);
-                        child.setText(text);
-                    }
-                    if ( child.hasTail() ) {
-                        std::wstring tail = child.tail();
-                        tail = this->handleInline(tail, patternIndex);
-                        child.setTail(tail);
+
+            boost::optional<std::wstring> result = pattern->handleMatch(match);  //!< first handleMatch (case String)
+            std::wstring placeholder;
+            if ( ! result ) {
+                Element node = pattern->handleMatch(Context::current().class_root, match);     //!< second handleMatch (case Node)
+                if ( node.isNull() ) {
+                    scan.keep(match);
+                    continue;
+                }
+                if ( ! node.hasChildren() || node.hasText() ) {
+                    //! We need to process current node too
+                    Element::List nodes = {node};
+                    append(nodes, node.children());
+                    for ( Element& child : nodes ) {
+                        if ( child.hasText() ) {
+                            std::wstring text = child.text();
+                            text = this->handleInline(text, patternIndex+1);
+                            child.setText(text);
+                        }
+                        if ( child.hasTail() ) {
+                            std::wstring tail = child.tail();
+                            tail = this->handleInline(tail, patternIndex);
+                            child.setTail(tail);
+                        }
                     }
                 }
-            }
 
-            placeholder = this->stashNode(node, pattern->type());
-        } else {
-            placeholder = this->stashNode(*result, pattern->type());
+                placeholder = this->stashNode(node, pattern->type());
+            } else {
+                placeholder = this->stashNode(*result, pattern->type());
+            }
+            scan.replace(match, placeholder, pattern->rescan());
         }
-
-        return boost::tuples::make_tuple((boost::wformat(L"%s%s%s%s")%leftData%match.str(1)%placeholder%match.str(match.size()-1)).str(), true, 0);
+        return scan.result();
     }
 
     /*!
@@ -361,11 +546,19 @@ private:
      */
     Element run(Element &tree)
     {
-        this->stashed_nodes = StashNodes();
+        Context& context = Context::current();
+        context.stashed_nodes.clear();
 
-        this->class_root = ElementTree(L"root");
+        //! inline nodes are created in the document itself, so inserting
+        //! them moves them instead of copying them between documents
+        context.class_root = tree.getOwnerDocument();
 
         try{
+            //! scratch parent of the tail results, emptied before each use
+            Element dumby_root(context.class_root, L"d_root");
+            Element dumby(dumby_root, L"d");
+            dumby_root.append(dumby);
+
             Element::List stack = {tree};
             while ( ! stack.empty() ) {
                 Element currElement = stack.back();
@@ -373,6 +566,8 @@ private:
                 typedef std::pair<Element, Element::List> QueueItem;
                 typedef std::list<QueueItem> Queue;
                 Queue insertQueue;
+                //! a snapshot: the tail results inserted below must not be
+                //! visited again by this loop
                 for ( Element& child : currElement.child() ) {
                     if ( child.hasText() ) {
                         std::wstring text = child.text();
@@ -383,9 +578,8 @@ private:
                     }
                     if ( child.hasTail() ) {
                         std::wstring tail = this->handleInline(child.tail());
-                        Element dumby_root(this->class_root, L"d_root");
-                        Element dumby(dumby_root, L"d");
-                        dumby_root.append(dumby);
+                        dumby.removeText();
+                        dumby.removeTail();
                         Element::List tailResult = this->processPlaceholders(tail, dumby);
                         if ( dumby.hasTail() ) {
                             child.setTail(dumby.tail());
@@ -402,7 +596,7 @@ private:
                             }
                         }
                     }
-                    if ( child.child().size() > 0 ) {
+                    if ( child.hasChildren() ) {
                         stack.push_back(child);
                     }
                 }
@@ -416,7 +610,7 @@ private:
                             element.setText(text);
                         }
                     }
-                    Element ref = ( element.child().size() > 0 ) ? element.getFirstElementChild() : Element::InvalidElement;
+                    Element ref = ( element.hasChildren() ) ? element.getFirstElementChild() : Element::InvalidElement;
                     for ( Element &newChild : lst ) {
                         if ( this->markdown->enable_attributes() ) {
                             //! Processing attributes
@@ -440,20 +634,19 @@ private:
                 }
             }
             return tree;
+        } catch (const BudgetExceeded&) {
+            throw;
         } catch (...) {
             std::cerr << "TreeProcessor::run() exception." << std::endl;
         }
-        this->class_root = ElementTree::InvalidElementTree;
+        context.class_root = ElementTree::InvalidElementTree;
         return Element::InvalidElement;
     }
 
 private:
     std::wstring placeholder_prefix;
     std::wstring placeholder_suffix;
-    unsigned int  placeholder_length;
-    boost::wregex placeholder_re;
-
-    ElementTree class_root;
+    Pattern::Triggers placeholder_chars;  //!< characters a replacement can bring in
 
 };
 
@@ -473,13 +666,14 @@ private:
      */
     void prettifyETree(Element &elem)
     {
-        if ( util::isBlockLevel(elem.getTagName()) && elem.getTagName() != L"code" && elem.getTagName() != L"pre" ) {
+        const HtmlTag::Atom tag = elem.getTag();
+        if ( HtmlTag::isBlockLevel(tag) && tag != HtmlTag::code && tag != HtmlTag::pre ) {
             if ( ( ! elem.hasText() || boost::algorithm::trim_copy(elem.text()).empty() )
-                 && elem.child().size() > 0 && util::isBlockLevel(elem.child().front().getTagName()) ) {
+                 && elem.hasChildren() && HtmlTag::isBlockLevel(elem.getFirstElementChild().getTag()) ) {
                 elem.setText(L"\n");
             }
-            for ( Element &e : elem.child() ) {
-                if ( util::isBlockLevel(e.getTagName()) ) {
+            for ( Element e : elem.children() ) {
+                if ( HtmlTag::isBlockLevel(e.getTag()) ) {
                     this->prettifyETree(e);
                 }
             }
@@ -510,8 +704,8 @@ public:
         }
         //! Clean up extra empty lines at end of code blocks.
         for ( Element& pre : root.getElementsByTagName(L"pre") ) {
-            if ( pre.child().size() > 0 && pre.child().front().getTagName() == L"code" ) {
-                pre.child().front().setText(boost::algorithm::trim_right_copy(pre.child().front().text())+L"\n");
+            if ( pre.hasChildren() && pre.getFirstElementChild().getTag() == HtmlTag::code ) {
+                pre.getFirstElementChild().setText(boost::algorithm::trim_right_copy(pre.getFirstElementChild().text())+L"\n");
             }
         }
         return Element::InvalidElement;
@@ -8,6 +8,8 @@
 #ifndef TREEPROCESSORS_H_
 #define TREEPROCESSORS_H_
 
+#include <vector>
+
 #include <boost/optional.hpp>
 #include <boost/tuple/tuple.hpp>
 
@@ -27,6 +29,10 @@ class Markdown;  //!< forward declaration
  *
  * Treeprocessors must extend markdown.Treeprocessor.
  *
+ * A Treeprocessor is shared by every conversion of its Markdown instance
+ * and may run on several threads at once; per-document state belongs in
+ * the current Context.
+ *
  */
 class TreeProcessor
 {
@@ -39,9 +45,7 @@ public:
 public:
     Markdown* markdown;
     typedef boost::tuples::tuple<boost::optional<std::wstring>, boost::optional<Element>> NodeItem;
-    typedef std::map<std::wstring, NodeItem> StashNodes;
-    StashNodes stashed_nodes;
-
+    typedef std::vector<NodeItem> StashNodes;  //!< indexed by placeholder id
 
 };
 
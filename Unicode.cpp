@@ -0,0 +1,473 @@
+/*
+ * Unicode.cpp
+ *
+ *  Created on: 2026/10/17
+ *      Author: mugwort_rc
+ */
+
+#include "Unicode.h"
+
+#include <algorithm>
+#include <cstring>
+#include <type_traits>
+
+#include <boost/cstdint.hpp>
+
+#if defined(__SSE2__) || defined(_M_X64) || ( defined(_M_IX86_FP) && _M_IX86_FP >= 2 )
+#define MARKDOWN_UNICODE_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace markdown{
+
+namespace {
+
+//! wchar_t as an unsigned code unit
+typedef std::conditional<sizeof(wchar_t) == 2, boost::uint16_t, boost::uint32_t>::type WideUnit;
+
+static_assert(sizeof(WideUnit) == sizeof(wchar_t), "wchar_t is 16 or 32 bits wide");
+
+#ifdef MARKDOWN_UNICODE_SSE2
+
+inline __m128i load(const unsigned char* src)
+{
+    return _mm_loadu_si128(reinterpret_cast<const __m128i*>(src));
+}
+inline void store(unsigned char* dest, __m128i value)
+{
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(dest), value);
+}
+
+/*!
+ * Sixteen units of `Width` bytes.
+ *
+ * narrow() packs the units at `src` into `bytes` if all of them are
+ * ASCII; widen() stores sixteen bytes as units at `dest`.
+ */
+template<std::size_t Width>
+struct Block;
+
+template<>
+struct Block<1>
+{
+    static bool narrow(const unsigned char* src, __m128i& bytes)
+    {
+        bytes = load(src);
+        return _mm_movemask_epi8(bytes) == 0;
+    }
+    static void widen(unsigned char* dest, __m128i bytes)
+    {
+        store(dest, bytes);
+    }
+};
+
+template<>
+struct Block<2>
+{
+    static bool narrow(const unsigned char* src, __m128i& bytes)
+    {
+        const __m128i a = load(src), b = load(src+16);
+        const __m128i high = _mm_and_si128(_mm_or_si128(a, b), _mm_set1_epi16(static_cast<short>(0xFF80)));
+        if ( _mm_movemask_epi8(_mm_cmpeq_epi16(high, _mm_setzero_si128())) != 0xFFFF ) {
+            return false;
+        }
+        bytes = _mm_packus_epi16(a, b);
+        return true;
+    }
+    static void widen(unsigned char* dest, __m128i bytes)
+    {
+        const __m128i zero = _mm_setzero_si128();
+        store(dest,    _mm_unpacklo_epi8(bytes, zero));
+        store(dest+16, _mm_unpackhi_epi8(bytes, zero));
+    }
+};
+
+template<>
+struct Block<4>
+{
+    static bool narrow(const unsigned char* src, __m128i& bytes)
+    {
+        const __m128i a = load(src), b = load(src+16), c = load(src+32), d = load(src+48);
+        const __m128i high = _mm_and_si128(_mm_or_si128(_mm_or_si128(a, b), _mm_or_si128(c, d)),
+                                           _mm_set1_epi32(static_cast<int>(0xFFFFFF80)));
+        if ( _mm_movemask_epi8(_mm_cmpeq_epi32(high, _mm_setzero_si128())) != 0xFFFF ) {
+            return false;
+        }
+        //! every value is below 0x80, so the saturating packs are plain truncations
+        bytes = _mm_packus_epi16(_mm_packs_epi32(a, b), _mm_packs_epi32(c, d));
+        return true;
+    }
+    static void widen(unsigned char* dest, __m128i bytes)
+    {
+        const __m128i zero = _mm_setzero_si128();
+        const __m128i lo = _mm_unpacklo_epi8(bytes, zero), hi = _mm_unpackhi_epi8(bytes, zero);
+        store(dest,    _mm_unpacklo_epi16(lo, zero));
+        store(dest+16, _mm_unpackhi_epi16(lo, zero));
+        store(dest+32, _mm_unpacklo_epi16(hi, zero));
+        store(dest+48, _mm_unpackhi_epi16(hi, zero));
+    }
+};
+
+#endif // MARKDOWN_UNICODE_SSE2
+
+template<typename Unit>
+inline Unit load_unit(const unsigned char* src)
+{
+    Unit unit;
+    std::memcpy(&unit, src, sizeof(Unit));
+    return unit;
+}
+
+/*!
+ * Number of leading ASCII units among the `size` units at `src`.
+ */
+template<typename Src>
+std::size_t ascii_units(const unsigned char* src, std::size_t size)
+{
+    std::size_t i = 0;
+#ifdef MARKDOWN_UNICODE_SSE2
+    __m128i bytes;
+    for ( ; i + 16 <= size; i += 16 ) {
+        if ( ! Block<sizeof(Src)>::narrow(src + i*sizeof(Src), bytes) ) {
+            break;
+        }
+    }
+#endif
+    while ( i < size && load_unit<Src>(src + i*sizeof(Src)) < 0x80 ) {
+        ++i;
+    }
+    return i;
+}
+
+/*!
+ * Copy the leading ASCII units among the `size` units at `src` to
+ * `dest`, converting them from Src to Dst, and return how many were
+ * copied.
+ */
+template<typename Src, typename Dst>
+std::size_t copy_ascii(const unsigned char* src, std::size_t size, unsigned char* dest)
+{
+    std::size_t i = 0;
+#ifdef MARKDOWN_UNICODE_SSE2
+    __m128i bytes;
+    for ( ; i + 16 <= size; i += 16 ) {
+        if ( ! Block<sizeof(Src)>::narrow(src + i*sizeof(Src), bytes) ) {
+            break;
+        }
+        Block<sizeof(Dst)>::widen(dest + i*sizeof(Dst), bytes);
+    }
+#endif
+    for ( ; i < size; ++i ) {
+        const Src unit = load_unit<Src>(src + i*sizeof(Src));
+        if ( unit >= 0x80 ) {
+            break;
+        }
+        const Dst out = static_cast<Dst>(unit);
+        std::memcpy(dest + i*sizeof(Dst), &out, sizeof(Dst));
+    }
+    return i;
+}
+
+inline bool in_range(unsigned char ch, unsigned char lo, unsigned char hi)
+{
+    return lo <= ch && ch <= hi;
+}
+
+/*!
+ * Decode the sequence starting with the non-ASCII byte at `it`.
+ *
+ * Returns its length and sets `cp` when it is well-formed; otherwise
+ * returns minus the length of its maximal invalid subpart.
+ */
+inline int decode_sequence(const unsigned char* it, const unsigned char* end, unsigned long& cp)
+{
+    const unsigned char lead = *it;
+    //! Second byte range and sequence length for each valid lead byte.
+    unsigned char lo = 0x80, hi = 0xBF;
+    int length = 0;
+    if ( in_range(lead, 0xC2, 0xDF) ) {
+        length = 2;
+        cp = lead & 0x1F;
+    } else if ( in_range(lead, 0xE0, 0xEF) ) {
+        length = 3;
+        cp = lead & 0x0F;
+        if ( lead == 0xE0 ) {
+            lo = 0xA0;
+        } else if ( lead == 0xED ) {
+            hi = 0x9F;  //!< exclude surrogates
+        }
+    } else if ( in_range(lead, 0xF0, 0xF4) ) {
+        length = 4;
+        cp = lead & 0x07;
+        if ( lead == 0xF0 ) {
+            lo = 0x90;
+        } else if ( lead == 0xF4 ) {
+            hi = 0x8F;  //!< exclude > U+10FFFF
+        }
+    } else {
+        return -1;
+    }
+    for ( int i = 1; i < length; ++i ) {
+        if ( it + i == end || ! in_range(it[i], i == 1 ? lo : 0x80, i == 1 ? hi : 0xBF) ) {
+            return -i;
+        }
+        cp = (cp << 6) | (it[i] & 0x3F);
+    }
+    return length;
+}
+
+} // end of anonymous namespace
+
+std::size_t ascii_prefix(const char* src, std::size_t size)
+{
+    return ascii_units<unsigned char>(reinterpret_cast<const unsigned char*>(src), size);
+}
+
+std::size_t ascii_prefix(const wchar_t* src, std::size_t size)
+{
+    return ascii_units<WideUnit>(reinterpret_cast<const unsigned char*>(src), size);
+}
+
+std::bitset<128> ascii_present(const wchar_t* src, std::size_t size, const std::bitset<128>& wanted)
+{
+    std::bitset<128> present;
+    if ( wanted.none() ) {
+        return present;
+    }
+    int lo = 0, hi = 127;
+    while ( ! wanted[lo] ) {
+        ++lo;
+    }
+    while ( ! wanted[hi] ) {
+        --hi;
+    }
+    std::size_t i = 0;
+    auto scan = [&](std::size_t end) {
+        for ( ; i < end; ++i ) {
+            const WideUnit unit = static_cast<WideUnit>(src[i]);
+            if ( unit < 0x80 && wanted[unit] ) {
+                present.set(unit);
+            }
+        }
+    };
+#ifdef MARKDOWN_UNICODE_SSE2
+    const unsigned char* units = reinterpret_cast<const unsigned char*>(src);
+    const __m128i below = _mm_set1_epi8(static_cast<char>(lo));
+    const __m128i above = _mm_set1_epi8(static_cast<char>(hi));
+    //! spaces are inside the range of most sets but seldom wanted;
+    //! 0x80 never occurs among packed ASCII characters
+    const __m128i space = _mm_set1_epi8(static_cast<char>(wanted[' '] ? 0x80 : ' '));
+    __m128i bytes;
+    while ( i + 16 <= size ) {
+        if ( Block<sizeof(wchar_t)>::narrow(units + i*sizeof(wchar_t), bytes) ) {
+            const __m128i outside = _mm_or_si128(_mm_or_si128(_mm_cmplt_epi8(bytes, below), _mm_cmpgt_epi8(bytes, above)),
+                                                 _mm_cmpeq_epi8(bytes, space));
+            if ( _mm_movemask_epi8(outside) == 0xFFFF ) {
+                i += 16;
+                continue;
+            }
+        }
+        scan(i + 16);
+        if ( present == wanted ) {
+            return present;
+        }
+    }
+#endif
+    scan(size);
+    return present;
+}
+
+std::size_t utf8_valid_prefix(boost::string_view src)
+{
+    const unsigned char* begin = reinterpret_cast<const unsigned char*>(src.data());
+    const unsigned char* it    = begin;
+    const unsigned char* end   = begin + src.size();
+    while ( it != end ) {
+        if ( *it < 0x80 ) {
+            it += ascii_units<unsigned char>(it, end - it);
+            if ( it == end ) {
+                break;
+            }
+        }
+        unsigned long cp;
+        int length = decode_sequence(it, end, cp);
+        if ( length < 0 ) {
+            break;
+        }
+        it += length;
+    }
+    return it - begin;
+}
+
+void utf8_decode(boost::string_view src, std::wstring& dest)
+{
+    if ( src.empty() ) {
+        return;
+    }
+    const unsigned char* it  = reinterpret_cast<const unsigned char*>(src.data());
+    const unsigned char* end = it + src.size();
+    //! every byte yields at most one wchar_t
+    const std::size_t offset = dest.size();
+    dest.resize(offset + src.size());
+    wchar_t* out = &dest[0] + offset;
+    while ( it != end ) {
+        if ( *it < 0x80 ) {
+            std::size_t run = copy_ascii<unsigned char, WideUnit>(it, end - it, reinterpret_cast<unsigned char*>(out));
+            it  += run;
+            out += run;
+            if ( it == end ) {
+                break;
+            }
+        }
+        unsigned long cp = 0;
+        int length = decode_sequence(it, end, cp);
+        if ( length < 0 ) {
+            //! Replace the maximal invalid subpart with a single U+FFFD.
+            *out++ = REPLACEMENT_CHARACTER;
+            it += -length;
+        } else if ( sizeof(wchar_t) == 2 && cp >= 0x10000 ) {
+            cp -= 0x10000;
+            *out++ = static_cast<wchar_t>(0xD800 + (cp >> 10));
+            *out++ = static_cast<wchar_t>(0xDC00 + (cp & 0x3FF));
+            it += length;
+        } else {
+            *out++ = static_cast<wchar_t>(cp);
+            it += length;
+        }
+    }
+    dest.resize(out - dest.data());
+}
+
+std::wstring utf8_decode(boost::string_view src)
+{
+    std::wstring result;
+    utf8_decode(src, result);
+    return result;
+}
+
+void utf8_encode(const wchar_t* src, std::size_t size, std::string& dest)
+{
+    const wchar_t* end = src + size;
+    const std::size_t offset = dest.size();
+    //! Room for the rest as ASCII plus one four byte sequence; grown
+    //! geometrically when other characters use it up.
+    dest.resize(offset + size + 3);
+    unsigned char* out = reinterpret_cast<unsigned char*>(&dest[0]) + offset;
+    while ( src != end ) {
+        std::size_t room = reinterpret_cast<unsigned char*>(&dest[0]) + dest.size() - out;
+        if ( room < static_cast<std::size_t>(end - src) + 3 ) {
+            const std::size_t written = out - reinterpret_cast<unsigned char*>(&dest[0]);
+            dest.resize(std::max(dest.size() * 2, written + (end - src) + 3));
+            out = reinterpret_cast<unsigned char*>(&dest[0]) + written;
+        }
+        if ( static_cast<WideUnit>(*src) < 0x80 ) {
+            std::size_t run = copy_ascii<WideUnit, unsigned char>(reinterpret_cast<const unsigned char*>(src), end - src, out);
+            src += run;
+            out += run;
+            if ( src == end ) {
+                break;
+            }
+        }
+        unsigned long cp = static_cast<unsigned long>(static_cast<WideUnit>(*src++));
+        if ( cp >= 0xD800 && cp <= 0xDFFF ) {
+            if ( sizeof(wchar_t) == 2 && cp <= 0xDBFF && src != end
+                 && static_cast<unsigned long>(*src) >= 0xDC00 && static_cast<unsigned long>(*src) <= 0xDFFF ) {
+                cp = 0x10000 + ((cp - 0xD800) << 10) + (static_cast<unsigned long>(*src++) - 0xDC00);
+            } else {
+                cp = REPLACEMENT_CHARACTER;
+            }
+        } else if ( cp > 0x10FFFF ) {
+            cp = REPLACEMENT_CHARACTER;
+        }
+        if ( cp < 0x800 ) {
+            *out++ = static_cast<unsigned char>(0xC0 | (cp >> 6));
+            *out++ = static_cast<unsigned char>(0x80 | (cp & 0x3F));
+        } else if ( cp < 0x10000 ) {
+            *out++ = static_cast<unsigned char>(0xE0 | (cp >> 12));
+            *out++ = static_cast<unsigned char>(0x80 | ((cp >> 6) & 0x3F));
+            *out++ = static_cast<unsigned char>(0x80 | (cp & 0x3F));
+        } else {
+            *out++ = static_cast<unsigned char>(0xF0 | (cp >> 18));
+            *out++ = static_cast<unsigned char>(0x80 | ((cp >> 12) & 0x3F));
+            *out++ = static_cast<unsigned char>(0x80 | ((cp >> 6) & 0x3F));
+            *out++ = static_cast<unsigned char>(0x80 | (cp & 0x3F));
+        }
+    }
+    dest.resize(out - reinterpret_cast<unsigned char*>(&dest[0]));
+}
+
+std::string utf8_encode(const std::wstring& src)
+{
+    std::string result;
+    utf8_encode(src.data(), src.size(), result);
+    return result;
+}
+
+std::size_t utf16_copy_plain(const wchar_t* src, std::size_t size, void* dest)
+{
+    unsigned char* out = static_cast<unsigned char*>(dest);
+    if ( sizeof(wchar_t) == 2 ) {
+        std::memcpy(out, src, size * 2);
+        return size;
+    }
+    const unsigned char* in = reinterpret_cast<const unsigned char*>(src);
+    std::size_t i = 0;
+#ifdef MARKDOWN_UNICODE_SSE2
+    //! packs_epi32 saturates signed values, so bias them into its range
+    const __m128i bias32 = _mm_set1_epi32(0x8000);
+    const __m128i bias16 = _mm_set1_epi16(static_cast<short>(0x8000));
+    const __m128i high = _mm_set1_epi32(static_cast<int>(0xFFFF0000));
+    for ( ; i + 8 <= size; i += 8 ) {
+        const __m128i a = load(in + i*4), b = load(in + i*4 + 16);
+        if ( _mm_movemask_epi8(_mm_cmpeq_epi32(_mm_and_si128(_mm_or_si128(a, b), high), _mm_setzero_si128())) != 0xFFFF ) {
+            break;
+        }
+        const __m128i packed = _mm_packs_epi32(_mm_sub_epi32(a, bias32), _mm_sub_epi32(b, bias32));
+        store(out + i*2, _mm_add_epi16(packed, bias16));
+    }
+#endif
+    for ( ; i < size; ++i ) {
+        const WideUnit unit = load_unit<WideUnit>(in + i*4);
+        if ( unit >= 0x10000 ) {
+            break;
+        }
+        const boost::uint16_t cu = static_cast<boost::uint16_t>(unit);
+        std::memcpy(out + i*2, &cu, 2);
+    }
+    return i;
+}
+
+std::size_t utf16_copy_plain(const void* src, std::size_t size, wchar_t* dest)
+{
+    const unsigned char* in = static_cast<const unsigned char*>(src);
+    unsigned char* out = reinterpret_cast<unsigned char*>(dest);
+    std::size_t i = 0;
+#ifdef MARKDOWN_UNICODE_SSE2
+    const __m128i mask = _mm_set1_epi16(static_cast<short>(0xF800));
+    const __m128i surrogate = _mm_set1_epi16(static_cast<short>(0xD800));
+    const __m128i zero = _mm_setzero_si128();
+    for ( ; i + 8 <= size; i += 8 ) {
+        const __m128i v = load(in + i*2);
+        if ( _mm_movemask_epi8(_mm_cmpeq_epi16(_mm_and_si128(v, mask), surrogate)) != 0 ) {
+            break;
+        }
+        if ( sizeof(wchar_t) == 2 ) {
+            store(out + i*2, v);
+        } else {
+            store(out + i*4,      _mm_unpacklo_epi16(v, zero));
+            store(out + i*4 + 16, _mm_unpackhi_epi16(v, zero));
+        }
+    }
+#endif
+    for ( ; i < size; ++i ) {
+        const boost::uint16_t cu = load_unit<boost::uint16_t>(in + i*2);
+        if ( ( cu & 0xF800 ) == 0xD800 ) {
+            break;
+        }
+        const WideUnit unit = cu;
+        std::memcpy(out + i*sizeof(wchar_t), &unit, sizeof(wchar_t));
+    }
+    return i;
+}
+
+} // end of namespace markdown
@@ -0,0 +1,163 @@
+/*
+ * Unicode.h
+ *
+ *  Created on: 2026/10/17
+ *      Author: mugwort_rc
+ */
+
+#ifndef UNICODE_H_
+#define UNICODE_H_
+
+#include <bitset>
+#include <cstddef>
+#include <string>
+
+#include <boost/utility/string_view.hpp>
+
+namespace markdown{
+
+/*!
+ * Replacement character used for malformed or unrepresentable input.
+ */
+const wchar_t REPLACEMENT_CHARACTER = 0xFFFD;
+
+/*!
+ * Transcoding between UTF-8, UTF-16 and wchar_t (UTF-32, or UTF-16 where
+ * wchar_t is 16 bits wide).
+ *
+ * The transcoders copy runs of ASCII (UTF-8) or of single code units
+ * (UTF-16) with SSE2 when the compiler targets it, sixteen or eight
+ * characters at a time, and only decode the other characters one by one.
+ * Decoders validate their input and replace what is malformed by U+FFFD.
+ */
+
+/*!
+ * Number of leading characters of `src` below U+0080.
+ */
+std::size_t ascii_prefix(const char* src, std::size_t size);
+std::size_t ascii_prefix(const wchar_t* src, std::size_t size);
+
+/*!
+ * The characters of `wanted` (indexed by code point) that occur in `src`.
+ *
+ * Runs of sixteen ASCII characters outside the range of `wanted` are
+ * passed over at once; the scan stops as soon as all of `wanted` is found.
+ */
+std::bitset<128> ascii_present(const wchar_t* src, std::size_t size, const std::bitset<128>& wanted);
+
+/*!
+ * Length of the longest prefix of `src` that is well-formed UTF-8 and
+ * does not end inside a sequence.
+ */
+std::size_t utf8_valid_prefix(boost::string_view src);
+inline bool utf8_valid(boost::string_view src)
+{
+    return utf8_valid_prefix(src) == src.size();
+}
+
+/*!
+ * Decode UTF-8 text and append it to `dest`.
+ *
+ * Malformed sequences (overlong forms, surrogates, code points above
+ * U+10FFFF, truncated sequences) are replaced by U+FFFD, one replacement
+ * per maximal invalid subpart. Code points outside the BMP are stored as
+ * surrogate pairs when wchar_t is 16 bits wide.
+ */
+void utf8_decode(boost::string_view src, std::wstring& dest);
+std::wstring utf8_decode(boost::string_view src);
+
+/*!
+ * Encode wide text as UTF-8 and append it to `dest`.
+ *
+ * Unpaired surrogates and values above U+10FFFF are written as U+FFFD.
+ */
+void utf8_encode(const wchar_t* src, std::size_t size, std::string& dest);
+std::string utf8_encode(const std::wstring& src);
+
+/*!
+ * Copy the leading characters of `src` that are a single UTF-16 code unit
+ * to the 16-bit code units at `dest`, or the leading code units at `src`
+ * that are not surrogates to `dest`, and return how many were copied.
+ * The building blocks of utf16_encode and utf16_decode, which accept any
+ * 16-bit code unit type.
+ */
+std::size_t utf16_copy_plain(const wchar_t* src, std::size_t size, void* dest);
+std::size_t utf16_copy_plain(const void* src, std::size_t size, wchar_t* dest);
+
+/*!
+ * Encode wide text as UTF-16 into `dest`, which must have room for
+ * 2 * size code units. Returns the end of the written range.
+ *
+ * `Char16` is any 16-bit code unit type (char16_t, XMLCh, ...).
+ */
+template<typename Char16>
+Char16* utf16_encode(const wchar_t* src, std::size_t size, Char16* dest)
+{
+    static_assert(sizeof(Char16) == 2, "UTF-16 code units are 16 bits wide");
+    const wchar_t* end = src + size;
+    while ( src != end ) {
+        std::size_t run = utf16_copy_plain(src, end - src, static_cast<void*>(dest));
+        src += run;
+        dest += run;
+        if ( src == end ) {
+            break;
+        }
+        //! beyond the BMP
+        unsigned long cp = static_cast<unsigned long>(*src++);
+        if ( cp <= 0x10FFFF ) {
+            cp -= 0x10000;
+            *dest++ = static_cast<Char16>(0xD800 + (cp >> 10));
+            *dest++ = static_cast<Char16>(0xDC00 + (cp & 0x3FF));
+        } else {
+            *dest++ = static_cast<Char16>(REPLACEMENT_CHARACTER);
+        }
+    }
+    return dest;
+}
+
+/*!
+ * Decode `size` UTF-16 code units and append them to `dest`.
+ *
+ * Surrogate pairs are combined when wchar_t is 32 bits wide; unpaired
+ * surrogates are replaced by U+FFFD.
+ */
+template<typename Char16>
+void utf16_decode(const Char16* src, std::size_t size, std::wstring& dest)
+{
+    static_assert(sizeof(Char16) == 2, "UTF-16 code units are 16 bits wide");
+    if ( size == 0 ) {
+        return;
+    }
+    //! every code unit yields at most one wchar_t
+    const std::size_t offset = dest.size();
+    dest.resize(offset + size);
+    wchar_t* out = &dest[0] + offset;
+    const Char16* end = src + size;
+    while ( src != end ) {
+        std::size_t run = utf16_copy_plain(static_cast<const void*>(src), end - src, out);
+        src += run;
+        out += run;
+        if ( src == end ) {
+            break;
+        }
+        //! a surrogate
+        unsigned long cu = static_cast<unsigned long>(*src++);
+        if ( cu <= 0xDBFF && src != end
+             && static_cast<unsigned long>(*src) >= 0xDC00 && static_cast<unsigned long>(*src) <= 0xDFFF ) {
+            unsigned long low = static_cast<unsigned long>(*src++);
+            if ( sizeof(wchar_t) == 2 ) {
+                *out++ = static_cast<wchar_t>(cu);
+                *out++ = static_cast<wchar_t>(low);
+            } else {
+                *out++ = static_cast<wchar_t>(0x10000 + ((cu - 0xD800) << 10) + (low - 0xDC00));
+            }
+        } else {
+            *out++ = REPLACEMENT_CHARACTER;
+        }
+    }
+    dest.resize(out - dest.data());
+}
+
+} // end of namespace markdown
+
+#endif // UNICODE_H_
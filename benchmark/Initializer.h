@@ -0,0 +1,40 @@
+/*
+ * Initializer.h
+ *
+ *  Created on: 2026/10/17
+ *      Author: mugwort_rc
+ */
+
+#ifndef INITIALIZER_H_
+#define INITIALIZER_H_
+
+#ifndef USE_ARENA_TREE
+#include <xercesc/util/PlatformUtils.hpp>
+#endif
+
+/*!
+ * Set up the tree backend for the lifetime of a benchmark.
+ *
+ * The Xerces backend needs the platform initialized before the first
+ * document; the arena backend needs nothing.
+ */
+class Initializer
+{
+public:
+#ifndef USE_ARENA_TREE
+    Initializer(void)
+    {
+        xercesc::XMLPlatformUtils::Initialize();
+    }
+    ~Initializer(void)
+    {
+        xercesc::XMLPlatformUtils::Terminate();
+    }
+#else
+    Initializer(void)
+    {}
+#endif
+
+};
+
+#endif // INITIALIZER_H_
@@ -0,0 +1,87 @@
+/*
+ * batch.cpp
+ *
+ *  Created on: 2026/10/17
+ *      Author: mugwort_rc
+ *
+ * Throughput of Markdown::convertBatch() from 1 to N worker threads.
+ *
+ * usage: batch [documents=4000] [max threads=hardware_concurrency]
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <boost/format.hpp>
+
+#include "MarkdownCpp.h"
+#include "Initializer.h"
+
+/*!
+ * A comment-sized document; `n` varies its length and content.
+ */
+std::wstring make_document(int n)
+{
+    std::wstring doc = (boost::wformat(L"Comment %d\n==========\n\n") % n).str();
+    for ( int i = 0; i < 1 + n % 5; ++i ) {
+        doc += (boost::wformat(L"This is *paragraph* %d with **strong** text, `code`, "
+                               L"a [link](http://example.com/%d \"title\") and an "
+                               L"<http://auto.example.com/> autolink.\n\n") % i % n).str();
+    }
+    if ( n % 2 == 0 ) {
+        doc += L"* first item\n* second _item_\n* third item\n\n";
+    }
+    if ( n % 3 == 0 ) {
+        doc += L"    int main(void) { return 0; }\n\n> quoted text\n> continues here\n\n";
+    }
+    return doc;
+}
+
+int main(int argc, char* argv[])
+{
+    Initializer init;
+
+    const int documents = argc > 1 ? std::atoi(argv[1]) : 4000;
+    unsigned int max_threads = argc > 2 ? std::atoi(argv[2]) : std::thread::hardware_concurrency();
+    max_threads = std::max(1u, max_threads);
+
+    std::vector<std::wstring> sources;
+    std::size_t bytes = 0;
+    for ( int i = 0; i < documents; ++i ) {
+        sources.push_back(make_document(i));
+        bytes += sources.back().size();
+    }
+
+    const markdown::Markdown md;
+    md.convertBatch(sources.begin(), sources.begin()+std::min<int>(documents, 100), 1);  //!< warm up
+
+    std::cout << documents << " documents, " << bytes << " characters" << std::endl;
+    std::cout << std::setw(8) << "threads" << std::setw(12) << "ms" << std::setw(14) << "docs/s" << std::setw(10) << "speedup" << std::endl;
+    std::vector<unsigned int> steps;
+    for ( unsigned int threads = 1; threads < max_threads; threads *= 2 ) {
+        steps.push_back(threads);
+    }
+    steps.push_back(max_threads);
+
+    double base = 0;
+    for ( unsigned int threads : steps ) {
+        auto begin = std::chrono::steady_clock::now();
+        std::vector<std::wstring> results = md.convertBatch(sources, threads);
+        auto end = std::chrono::steady_clock::now();
+        double ms = std::chrono::duration<double, std::milli>(end-begin).count();
+        if ( threads == 1 ) {
+            base = ms;
+        }
+        std::cout << std::setw(8) << threads
+                  << std::setw(12) << std::fixed << std::setprecision(1) << ms
+                  << std::setw(14) << std::setprecision(0) << documents / (ms / 1000.0)
+                  << std::setw(10) << std::setprecision(2) << base / ms << std::endl;
+    }
+    return 0;
+}
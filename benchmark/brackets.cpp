@@ -0,0 +1,150 @@
+/*
+ * brackets.cpp
+ *
+ *  Created on: 2026/10/17
+ *      Author: mugwort_rc
+ *
+ * Scaling of the link, image and reference patterns on bracket-dense
+ * paragraphs.
+ *
+ * One paragraph of inline links with and without titles, images,
+ * references, nested brackets and brackets that start no link is
+ * converted at doubling sizes. The built-in patterns search it with
+ * LinkScanner; for comparison the same paragraph is converted with those
+ * patterns searched for by their regular expressions. The growth
+ * exponent of time ~ size^k is fitted for both.
+ *
+ * usage: brackets [max chars=1048576] [seconds per run=5]
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "MarkdownCpp.h"
+#include "Initializer.h"
+
+/*!
+ * A pattern searched for by the regular expression of another one.
+ */
+class RegexSearch : public markdown::Pattern
+{
+public:
+    explicit RegexSearch(const boost::shared_ptr<markdown::Pattern>& pattern) :
+        markdown::Pattern(std::wstring()), pattern(pattern)
+    {
+        this->setRescan(pattern->rescan());
+    }
+
+    virtual bool search(std::wstring::const_iterator base,
+                        std::wstring::const_iterator first, std::wstring::const_iterator last,
+                        boost::wsmatch& match, boost::match_flag_type flags) const
+    { return boost::regex_search(first, last, match, this->pattern->getScanRegExp(), flags, base); }
+
+    virtual boost::optional<std::wstring> handleMatch(const boost::wsmatch& m)
+    { return this->pattern->handleMatch(m); }
+    virtual markdown::Element handleMatch(const markdown::ElementTree& doc, const boost::wsmatch& m)
+    { return this->pattern->handleMatch(doc, m); }
+
+    virtual std::wstring type(void) const
+    { return this->pattern->type(); }
+
+    virtual std::wstring unescape(const std::wstring& text)
+    { return this->pattern->unescape(text); }
+
+private:
+    boost::shared_ptr<markdown::Pattern> pattern;
+
+};
+
+/*!
+ * A paragraph of about `size` characters, with the references it uses.
+ */
+std::wstring paragraph(std::size_t size)
+{
+    const std::wstring unit = L"A [link](http://example.com/) and [another](<http://example.com/a b> \"Title\"), "
+                              L"an ![image](/img.png) and ![alt][logo], a [reference] [id] and [id], "
+                              L"[nested [brackets] here](/nested) and [a [b] c [d] e] that are no link, "
+                              L"[unknown] ids, a (parenthesis) and [empty]() targets. ";
+    std::wstring result;
+    result.reserve(size + unit.size());
+    while ( result.size() < size ) {
+        result += unit;
+    }
+    return result + L"\n\n[id]: http://example.com/id\n[logo]: /logo.png \"Logo\"\n";
+}
+
+/*!
+ * Best time of a few conversions, in seconds.
+ */
+double measure(const markdown::Markdown& md, const std::wstring& source)
+{
+    double best = 0;
+    double total = 0;
+    for ( int i = 0; i < 3 && total < 0.05; ++i ) {
+        auto begin = std::chrono::steady_clock::now();
+        md.convert(source);
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now()-begin).count();
+        best = i == 0 ? seconds : std::min(best, seconds);
+        total += seconds;
+    }
+    return best;
+}
+
+/*!
+ * Least squares slope of log(time) over log(size).
+ */
+double fit_exponent(const std::vector<std::pair<double, double> >& points)
+{
+    double sx = 0, sy = 0, sxx = 0, sxy = 0;
+    for ( const std::pair<double, double>& p : points ) {
+        double x = std::log(p.first), y = std::log(p.second);
+        sx += x; sy += y; sxx += x*x; sxy += x*y;
+    }
+    const double n = points.size();
+    return (n*sxy - sx*sy) / (n*sxx - sx*sx);
+}
+
+int main(int argc, char* argv[])
+{
+    Initializer init;
+
+    const std::size_t max_size = argc > 1 ? std::atoi(argv[1]) : 1024*1024;
+    const double seconds = argc > 2 ? std::atof(argv[2]) : 5.0;
+
+    const markdown::Markdown scanner;
+    markdown::Markdown regex;
+    for ( const char* name : {"reference", "link", "image_link", "image_reference", "short_reference"} ) {
+        regex.inlinePatterns.append(name, boost::shared_ptr<markdown::Pattern>(new RegexSearch(regex.inlinePatterns[name])));
+    }
+    scanner.convert(L"warm [up](/)");
+    regex.convert(L"warm [up](/)");
+
+    std::cout << std::setw(10) << "chars" << std::setw(14) << "scanner" << std::setw(14) << "regex" << "  (ms)" << std::endl;
+    std::vector<std::pair<double, double> > scanner_points, regex_points;
+    bool searching = true;
+    for ( std::size_t size = 1024; size <= max_size; size *= 2 ) {
+        const std::wstring source = paragraph(size);
+        const double scanner_time = measure(scanner, source);
+        scanner_points.push_back(std::make_pair(static_cast<double>(source.size()), scanner_time));
+        std::cout << std::setw(10) << source.size() << std::fixed << std::setprecision(3)
+                  << std::setw(14) << scanner_time*1000;
+        if ( searching ) {
+            const double regex_time = measure(regex, source);
+            regex_points.push_back(std::make_pair(static_cast<double>(source.size()), regex_time));
+            std::cout << std::setw(14) << regex_time*1000;
+            searching = regex_time*4 < seconds;  //!< the next size would take too long
+        }
+        std::cout << std::endl;
+    }
+    std::cout << "exponent" << std::setprecision(2)
+              << std::setw(16) << fit_exponent(scanner_points)
+              << std::setw(14) << fit_exponent(regex_points) << std::endl;
+    return 0;
+}
@@ -0,0 +1,199 @@
+/*
+ * complexity.cpp
+ *
+ *  Created on: 2026/10/17
+ *      Author: mugwort_rc
+ *
+ * Growth of Markdown::convert() on adversarial inputs.
+ *
+ * Each shape is converted at doubling sizes; the growth exponent k of
+ * time ~ size^k is fitted over the sizes slow enough to be measured. The
+ * program exits with 1 if any shape grows faster than the bound, throws
+ * or crashes, and with 2 if a single conversion runs past the hard limit
+ * (ten times the time per run), since a running conversion cannot be
+ * interrupted. Each shape runs in a child process of its own, so a crash
+ * or a stuck conversion fails that shape and the others still run.
+ *
+ * usage: complexity [bound=1.3] [max chars=1048576] [seconds per run=2] [shape]
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <functional>
+#include <future>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "MarkdownCpp.h"
+#include "Initializer.h"
+
+/*!
+ * An input of `size` characters.
+ */
+typedef std::function<std::wstring(std::size_t)> Shape;
+
+std::wstring repeat(const std::wstring& unit, std::size_t size)
+{
+    std::wstring result;
+    result.reserve(size + unit.size());
+    while ( result.size() < size ) {
+        result += unit;
+    }
+    return result;
+}
+
+struct Adversary
+{
+    std::string name;
+    Shape       generate;
+};
+
+std::vector<Adversary> adversaries(void)
+{
+    std::vector<Adversary> result;
+    result.push_back(Adversary{"open_brackets",   [](std::size_t n) { return repeat(L"[a ", n); }});
+    result.push_back(Adversary{"bracket_pairs",   [](std::size_t n) { return repeat(L"[", n/2) + repeat(L"]", n/2); }});
+    result.push_back(Adversary{"asterisk_run",    [](std::size_t n) { return L"a " + repeat(L"*", n); }});
+    result.push_back(Adversary{"open_emphasis",   [](std::size_t n) { return repeat(L"*a ", n); }});
+    result.push_back(Adversary{"underscore_run",  [](std::size_t n) { return L"a " + repeat(L"_", n) + L" a"; }});
+    result.push_back(Adversary{"open_angle",      [](std::size_t n) { return repeat(L"<a ", n); }});
+    result.push_back(Adversary{"backtick_run",    [](std::size_t n) { return repeat(L"`", n); }});
+    result.push_back(Adversary{"nested_quote",    [](std::size_t n) { return repeat(L">", n) + L" text"; }});
+    result.push_back(Adversary{"quote_lines",     [](std::size_t n) { return repeat(L"> > > quoted line\n", n); }});
+    result.push_back(Adversary{"nested_list",     [](std::size_t n) {
+        std::wstring doc;
+        for ( int level = 0; doc.size() < n; ++level ) {
+            doc += std::wstring(4*(level % 64), L' ') + L"* item\n";
+        }
+        return doc;
+    }});
+    return result;
+}
+
+/*!
+ * Best time of a few conversions, in seconds, or -1 if one threw. Exits
+ * the process if one conversion outlives `limit`.
+ */
+double measure(const markdown::Markdown& md, const std::wstring& source, double limit)
+{
+    double best = limit;
+    double total = 0;
+    for ( int i = 0; i < 3 && total < 0.05; ++i ) {
+        std::packaged_task<double(void)> task([&md, &source]() {
+            auto begin = std::chrono::steady_clock::now();
+            md.convert(source);
+            return std::chrono::duration<double>(std::chrono::steady_clock::now()-begin).count();
+        });
+        std::future<double> result = task.get_future();
+        std::thread(std::move(task)).detach();
+        if ( result.wait_for(std::chrono::duration<double>(limit)) != std::future_status::ready ) {
+            std::cout << "  conversion of " << source.size() << " characters did not finish in "
+                      << limit << " s" << std::endl;
+            std::_Exit(2);
+        }
+        double seconds;
+        try {
+            seconds = result.get();
+        } catch ( const std::exception& e ) {
+            std::cout << "  conversion of " << source.size() << " characters threw: " << e.what() << std::endl;
+            return -1;
+        }
+        best = std::min(best, seconds);
+        total += seconds;
+    }
+    return best;
+}
+
+/*!
+ * Least squares slope of log(time) over log(size).
+ */
+double fit_exponent(const std::vector<std::pair<double, double> >& points)
+{
+    double sx = 0, sy = 0, sxx = 0, sxy = 0;
+    for ( const std::pair<double, double>& p : points ) {
+        double x = std::log(p.first), y = std::log(p.second);
+        sx += x; sy += y; sxx += x*x; sxy += x*y;
+    }
+    const double n = points.size();
+    return (n*sxy - sx*sy) / (n*sxx - sx*sx);
+}
+
+/*!
+ * Fit the growth of one shape. Returns the exit status.
+ */
+int run(const Adversary& adversary, double bound, std::size_t max_size, double seconds)
+{
+    const double noise = 1e-3;  //!< times below this are not fitted
+
+    const markdown::Markdown md;
+    md.convert(L"warm *up*");
+
+    std::vector<std::pair<double, double> > points;
+    for ( std::size_t size = 1024; size <= max_size; size *= 2 ) {
+        const std::wstring source = adversary.generate(size);
+        const double time = measure(md, source, 10*seconds);
+        if ( time < 0 ) {
+            std::cout << "  FAILED" << std::endl;
+            return 1;
+        }
+        std::cout << "  " << std::setw(10) << source.size() << " chars"
+                  << std::setw(12) << std::fixed << std::setprecision(3) << time*1000 << " ms" << std::endl;
+        if ( time >= noise ) {
+            points.push_back(std::make_pair(static_cast<double>(source.size()), time));
+        }
+        if ( time > seconds ) {
+            break;  //!< the next size would take too long
+        }
+    }
+    if ( points.size() < 2 ) {
+        std::cout << "  too fast to fit: ok" << std::endl;
+        return 0;
+    }
+    const double exponent = fit_exponent(points);
+    const bool ok = exponent <= bound;
+    std::cout << "  exponent " << std::setprecision(2) << exponent
+              << (ok ? " <= " : " > ") << bound << (ok ? ": ok" : ": FAILED") << std::endl;
+    return ok ? 0 : 1;
+}
+
+int main(int argc, char* argv[])
+{
+    Initializer init;
+
+    const double bound = argc > 1 ? std::atof(argv[1]) : 1.3;
+    const std::size_t max_size = argc > 2 ? std::atoi(argv[2]) : 1024*1024;
+    const double seconds = argc > 3 ? std::atof(argv[3]) : 2.0;
+    const std::string only = argc > 4 ? argv[4] : "";
+
+    int status = 0;
+    for ( const Adversary& adversary : adversaries() ) {
+        if ( ! only.empty() && only != adversary.name ) {
+            continue;
+        }
+        std::cout << adversary.name << std::endl;
+        const pid_t pid = fork();
+        if ( pid == 0 ) {
+            std::_Exit(run(adversary, bound, max_size, seconds));
+        }
+        int result = pid < 0 ? run(adversary, bound, max_size, seconds) : 0;
+        int child;
+        if ( pid > 0 && waitpid(pid, &child, 0) == pid ) {
+            if ( WIFEXITED(child) ) {
+                result = WEXITSTATUS(child);
+            } else {
+                std::cout << "  killed by signal " << WTERMSIG(child) << ": FAILED" << std::endl;
+                result = 1;
+            }
+        }
+        status = std::max(status, result);
+    }
+    return status;
+}
@@ -0,0 +1,221 @@
+/*
+ * constructs.cpp
+ *
+ *  Created on: 2026/10/17
+ *      Author: mugwort_rc
+ *
+ * Throughput of Markdown::convert() per Markdown construct.
+ *
+ * Every construct gets a synthetic corpus that stresses the processors
+ * handling it: plain paragraphs, emphasis and links for the
+ * InlineProcessor, deep lists for the OList/UList/ListIndent processors,
+ * raw html for the HtmlBlockProcessor, tables for the tables extension and
+ * so on. The corpus is split into documents of a fixed size and converted
+ * several times; the best run is reported in MB/s and ns/byte of UTF-8
+ * source.
+ *
+ * usage: constructs [KiB per construct=1024] [KiB per document=16] [repeat=5] [construct]
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <string>
+#include <vector>
+
+#include <boost/format.hpp>
+
+#include "MarkdownCpp.h"
+#include "Unicode.h"
+#include "extensions/tables.h"
+#include "Initializer.h"
+
+/*!
+ * Append the `n`th block of a construct to a document.
+ */
+typedef std::function<void(std::wstring&, int)> Generator;
+
+void plain_paragraph(std::wstring& doc, int n)
+{
+    for ( int line = 0; line < 8; ++line ) {
+        doc += (boost::wformat(L"Paragraph %d line %d has nothing but plain words in it, "
+                               L"so only the block parser and the serializer see work.\n") % n % line).str();
+    }
+    doc += L"\n";
+}
+
+void inline_paragraph(std::wstring& doc, int n)
+{
+    for ( int line = 0; line < 8; ++line ) {
+        doc += (boost::wformat(L"Some *emphasis* and **strong %d** text, `code %d`, a "
+                               L"[link](http://example.com/%d \"title\"), a [reference][r%d], "
+                               L"<http://auto.example.com/%d>, ![image](/img/%d.png) and _more_ "
+                               L"café 日本語 &amp; entities.  \n")
+                % n % line % line % (n % 16) % line % line).str();
+    }
+    doc += L"\n";
+    if ( n % 16 == 0 ) {
+        for ( int r = 0; r < 16; ++r ) {
+            doc += (boost::wformat(L"[r%d]: http://example.com/ref/%d \"Reference %d\"\n") % r % r % r).str();
+        }
+        doc += L"\n";
+    }
+}
+
+void nested_list(std::wstring& doc, int n, bool ordered)
+{
+    const int depth = 6;
+    for ( int item = 0; item < 4; ++item ) {
+        for ( int level = 0; level < depth; ++level ) {
+            doc += std::wstring(4*level, L' ');
+            doc += ordered ? (boost::wformat(L"%d. ") % (item+1)).str() : std::wstring(L"* ");
+            doc += (boost::wformat(L"item %d of list %d at level %d with *some* text\n") % item % n % level).str();
+        }
+    }
+    doc += L"\n";
+}
+
+void loose_list(std::wstring& doc, int n)
+{
+    for ( int item = 0; item < 6; ++item ) {
+        doc += (boost::wformat(L"-   item %d of list %d\n\n    continued in an indented paragraph\n\n") % item % n).str();
+    }
+    doc += L"\nbreak\n\n";
+}
+
+void raw_html(std::wstring& doc, int n)
+{
+    doc += (boost::wformat(L"<div class=\"block%d\">\n<table>\n<tr><td>%d</td><td>cell</td></tr>\n"
+                           L"<tr><td>*not emphasis*</td><td><span>inline</span></td></tr>\n"
+                           L"</table>\n</div>\n\n"
+                           L"<!-- comment %d -->\n\n"
+                           L"Text with <span class=\"x\">inline</span> html and an &entity; %d.\n\n") % n % n % n % n).str();
+}
+
+void table(std::wstring& doc, int n)
+{
+    doc += L"First | Second | Third | Fourth\n"
+           L":---- | :----: | ----: | ------\n";
+    for ( int row = 0; row < 32; ++row ) {
+        doc += (boost::wformat(L"row %d | *cell* %d | `%d` | [link](http://example.com/%d)\n") % row % n % row % row).str();
+    }
+    doc += L"\n";
+}
+
+void code_block(std::wstring& doc, int n)
+{
+    for ( int line = 0; line < 12; ++line ) {
+        doc += (boost::wformat(L"    if ( value[%d] < %d && *ptr ) { return <tag>; }\n") % line % n).str();
+    }
+    doc += L"\n";
+}
+
+void blockquote(std::wstring& doc, int n)
+{
+    for ( int level = 1; level <= 4; ++level ) {
+        doc += std::wstring(level, L'>');
+        doc += (boost::wformat(L" quoted text %d at level %d\n") % n % level).str();
+        doc += std::wstring(level, L'>');
+        doc += L"\n";
+    }
+    doc += L"\n";
+}
+
+void headers(std::wstring& doc, int n)
+{
+    doc += (boost::wformat(L"# Header %d\n\nSetext %d\n---------\n\n## Section %d ##\n\n* * *\n\n") % n % n % n).str();
+}
+
+struct Construct
+{
+    std::string name;
+    Generator   generate;
+    bool        tables;
+};
+
+std::vector<Construct> constructs(void)
+{
+    using namespace std::placeholders;
+    std::vector<Construct> result;
+    result.push_back(Construct{"paragraph",  plain_paragraph,                  false});
+    result.push_back(Construct{"inline",     inline_paragraph,                 false});
+    result.push_back(Construct{"olist",      std::bind(nested_list, _1, _2, true),  false});
+    result.push_back(Construct{"ulist",      std::bind(nested_list, _1, _2, false), false});
+    result.push_back(Construct{"loose_list", loose_list,                       false});
+    result.push_back(Construct{"html",       raw_html,                         false});
+    result.push_back(Construct{"table",      table,                            true});
+    result.push_back(Construct{"code",       code_block,                       false});
+    result.push_back(Construct{"blockquote", blockquote,                       false});
+    result.push_back(Construct{"header",     headers,                          false});
+    return result;
+}
+
+/*!
+ * Split `total` characters of a construct into documents of `size`.
+ */
+std::vector<std::wstring> make_corpus(const Generator& generate, std::size_t total, std::size_t size)
+{
+    std::vector<std::wstring> corpus;
+    std::size_t chars = 0;
+    int n = 0;
+    while ( chars < total ) {
+        std::wstring doc;
+        while ( doc.size() < size ) {
+            generate(doc, n++);
+        }
+        chars += doc.size();
+        corpus.push_back(doc);
+    }
+    return corpus;
+}
+
+int main(int argc, char* argv[])
+{
+    Initializer init;
+
+    const std::size_t total = (argc > 1 ? std::atoi(argv[1]) : 1024) * 1024;
+    const std::size_t size  = (argc > 2 ? std::atoi(argv[2]) : 16) * 1024;
+    const int repeat = std::max(1, argc > 3 ? std::atoi(argv[3]) : 5);
+    const std::string only = argc > 4 ? argv[4] : "";
+
+    const markdown::Markdown md;
+    const markdown::Markdown md_tables({markdown::TableExtension::generate()});
+
+    std::cout << std::setw(12) << "construct" << std::setw(8) << "docs" << std::setw(12) << "bytes"
+              << std::setw(12) << "ms" << std::setw(10) << "MB/s" << std::setw(10) << "ns/byte" << std::endl;
+    for ( const Construct& construct : constructs() ) {
+        if ( ! only.empty() && only != construct.name ) {
+            continue;
+        }
+        const markdown::Markdown& converter = construct.tables ? md_tables : md;
+        std::vector<std::wstring> corpus = make_corpus(construct.generate, total, size);
+        std::size_t bytes = 0;
+        for ( const std::wstring& doc : corpus ) {
+            bytes += markdown::utf8_encode(doc).size();
+        }
+
+        std::wstring html;
+        converter.convert(corpus.front(), html);  //!< warm up
+        double best = std::numeric_limits<double>::max();
+        for ( int i = 0; i < repeat; ++i ) {
+            auto begin = std::chrono::steady_clock::now();
+            for ( const std::wstring& doc : corpus ) {
+                converter.convert(doc, html);
+            }
+            auto end = std::chrono::steady_clock::now();
+            best = std::min(best, std::chrono::duration<double, std::milli>(end-begin).count());
+        }
+
+        std::cout << std::setw(12) << construct.name
+                  << std::setw(8) << corpus.size()
+                  << std::setw(12) << bytes
+                  << std::setw(12) << std::fixed << std::setprecision(1) << best
+                  << std::setw(10) << std::setprecision(2) << bytes / (best * 1000.0)
+                  << std::setw(10) << std::setprecision(1) << best * 1e6 / bytes << std::endl;
+    }
+    return 0;
+}
@@ -0,0 +1,116 @@
+/*
+ * inline.cpp
+ *
+ *  Created on: 2026/10/17
+ *      Author: mugwort_rc
+ *
+ * Scaling of the InlineProcessor on long paragraphs.
+ *
+ * One paragraph mixing plain words with emphasis, strong, code spans,
+ * escapes and line breaks, whose handlers do the same work whatever the
+ * length of the paragraph, is converted at doubling sizes. Every inline
+ * pattern searches the paragraph once; for comparison the same paragraph
+ * is converted with every pattern set to Pattern::rescan_all, which
+ * searches the whole paragraph again after each replacement as the
+ * original engine did. The growth exponent of time ~ size^k is fitted
+ * for both.
+ *
+ * usage: inline [max chars=1048576] [seconds per run=5]
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "MarkdownCpp.h"
+#include "Initializer.h"
+
+/*!
+ * A paragraph of about `size` characters.
+ */
+std::wstring paragraph(std::size_t size)
+{
+    const std::wstring unit = L"Some *emphasis* and **strong** words with `code`, \\*escapes\\* "
+                              L"and ***both*** at once, _underscores_ and a line  \nbreak. ";
+    std::wstring result;
+    result.reserve(size + unit.size());
+    while ( result.size() < size ) {
+        result += unit;
+    }
+    return result;
+}
+
+/*!
+ * Best time of a few conversions, in seconds.
+ */
+double measure(const markdown::Markdown& md, const std::wstring& source)
+{
+    double best = 0;
+    double total = 0;
+    for ( int i = 0; i < 3 && total < 0.05; ++i ) {
+        auto begin = std::chrono::steady_clock::now();
+        md.convert(source);
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now()-begin).count();
+        best = i == 0 ? seconds : std::min(best, seconds);
+        total += seconds;
+    }
+    return best;
+}
+
+/*!
+ * Least squares slope of log(time) over log(size).
+ */
+double fit_exponent(const std::vector<std::pair<double, double> >& points)
+{
+    double sx = 0, sy = 0, sxx = 0, sxy = 0;
+    for ( const std::pair<double, double>& p : points ) {
+        double x = std::log(p.first), y = std::log(p.second);
+        sx += x; sy += y; sxx += x*x; sxy += x*y;
+    }
+    const double n = points.size();
+    return (n*sxy - sx*sy) / (n*sxx - sx*sx);
+}
+
+int main(int argc, char* argv[])
+{
+    Initializer init;
+
+    const std::size_t max_size = argc > 1 ? std::atoi(argv[1]) : 1024*1024;
+    const double seconds = argc > 2 ? std::atof(argv[2]) : 5.0;
+
+    const markdown::Markdown single;
+    const markdown::Markdown rescan;
+    for ( std::size_t i = 0; i < rescan.inlinePatterns.size(); ++i ) {
+        rescan.inlinePatterns.at(i)->setRescan(markdown::Pattern::rescan_all);
+    }
+    single.convert(L"warm *up*");
+    rescan.convert(L"warm *up*");
+
+    std::cout << std::setw(10) << "chars" << std::setw(14) << "single pass" << std::setw(14) << "rescan" << "  (ms)" << std::endl;
+    std::vector<std::pair<double, double> > single_points, rescan_points;
+    bool rescanning = true;
+    for ( std::size_t size = 1024; size <= max_size; size *= 2 ) {
+        const std::wstring source = paragraph(size);
+        const double single_time = measure(single, source);
+        single_points.push_back(std::make_pair(static_cast<double>(source.size()), single_time));
+        std::cout << std::setw(10) << source.size() << std::fixed << std::setprecision(3)
+                  << std::setw(14) << single_time*1000;
+        if ( rescanning ) {
+            const double rescan_time = measure(rescan, source);
+            rescan_points.push_back(std::make_pair(static_cast<double>(source.size()), rescan_time));
+            std::cout << std::setw(14) << rescan_time*1000;
+            rescanning = rescan_time*4 < seconds;  //!< the next size would take too long
+        }
+        std::cout << std::endl;
+    }
+    std::cout << "exponent" << std::setprecision(2)
+              << std::setw(16) << fit_exponent(single_points)
+              << std::setw(14) << fit_exponent(rescan_points) << std::endl;
+    return 0;
+}
@@ -0,0 +1,149 @@
+/*
+ * rescan.cpp
+ *
+ *  Created on: 2026/10/17
+ *      Author: mugwort_rc
+ *
+ * Conformance of the single pass InlineProcessor against the original
+ * engine.
+ *
+ * A corpus of random documents is generated from a seed: paragraphs,
+ * headers, list items and quotes made of words mixed with emphasis,
+ * strong, code spans, escapes, links, images, references, autolinks, raw
+ * html, entities, line breaks and unbalanced delimiters. Every document
+ * is converted with the built-in patterns and again with every pattern
+ * set to Pattern::rescan_all, which searches the whole text again after
+ * each replacement as the original engine did. The documents that
+ * convert differently are printed and the program exits with 1 if there
+ * is any.
+ *
+ * With an output directory the corpus is also written there, one
+ * caseNNNN.md per document, for comparing other builds.
+ *
+ * usage: rescan [documents=2000] [seed=1] [output directory]
+ */
+
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "MarkdownCpp.h"
+#include "Unicode.h"
+#include "Initializer.h"
+
+/*!
+ * Random documents built from inline constructs.
+ */
+class Corpus
+{
+public:
+    explicit Corpus(unsigned int seed) :
+        random(seed)
+    {}
+
+    std::wstring document(void)
+    {
+        std::wstring doc;
+        const int blocks = this->below(6) + 1;
+        for ( int i = 0; i < blocks; ++i ) {
+            switch ( this->below(8) ) {
+            case 0:
+                doc += std::wstring(this->below(3) + 1, L'#') + L" " + this->line() + L"\n\n";
+                break;
+            case 1:
+                doc += L"* " + this->line() + L"\n* " + this->line() + L"\n\n";
+                break;
+            case 2:
+                doc += L"> " + this->line() + L"\n> " + this->line() + L"\n\n";
+                break;
+            default:
+                doc += this->line() + L"\n" + this->line() + L"\n\n";
+                break;
+            }
+        }
+        doc += L"[id]: http://example.com/id \"Id\"\n[logo]: /logo.png\n";
+        return doc;
+    }
+
+private:
+    int below(int n)
+    {
+        return std::uniform_int_distribution<int>(0, n - 1)(this->random);
+    }
+
+    std::wstring pick(const std::vector<std::wstring>& tokens)
+    {
+        return tokens[this->below(tokens.size())];
+    }
+
+    std::wstring line(void)
+    {
+        static const std::vector<std::wstring> words = {
+            L"word", L"text", L"a", L"the", L"some", L"more", L"snake_case_word", L"2*3", L"a_b", L"x*y*z",
+        };
+        static const std::vector<std::wstring> tokens = {
+            L"*", L"**", L"***", L"_", L"__", L"___", L"`", L"``", L"\\*", L"\\_", L"\\`", L"\\[", L"\\\\",
+            L"[", L"]", L"(", L")", L"![", L"<", L">", L"&", L"&amp;", L"&copy;", L"&#42;", L"  \n",
+            L"*em*", L"**strong**", L"***both***", L"_em_", L"__strong__", L"*a **b** c*", L"**a *b* c**",
+            L"`code`", L"`` a ` b ``", L"`*not em*`", L"[link](/url)", L"[link](/url \"title\")",
+            L"[link](<http://example.com/a b>)", L"[*em* link](/em)", L"![image](/img.png \"Title\")",
+            L"[ref][id]", L"[ref] [id]", L"[id]", L"![alt][logo]", L"[unknown][none]", L"[a [b] c](/n)",
+            L"<http://example.com/>", L"<me@example.com>", L"<span>", L"</span>", L"<b>bold</b>",
+            L"<!-- comment -->", L"<span class=\"x\">*in*</span>",
+        };
+        std::wstring result;
+        const int length = this->below(40) + 1;
+        for ( int i = 0; i < length; ++i ) {
+            if ( ! result.empty() && this->below(3) != 0 ) {
+                result += L" ";
+            }
+            result += this->below(2) == 0 ? this->pick(words) : this->pick(tokens);
+        }
+        return result;
+    }
+
+private:
+    std::mt19937 random;
+
+};
+
+int main(int argc, char* argv[])
+{
+    Initializer init;
+
+    const int documents = argc > 1 ? std::atoi(argv[1]) : 2000;
+    const unsigned int seed = argc > 2 ? std::atoi(argv[2]) : 1;
+    const std::string directory = argc > 3 ? argv[3] : "";
+
+    const markdown::Markdown single;
+    const markdown::Markdown rescan;
+    for ( std::size_t i = 0; i < rescan.inlinePatterns.size(); ++i ) {
+        rescan.inlinePatterns.at(i)->setRescan(markdown::Pattern::rescan_all);
+    }
+
+    Corpus corpus(seed);
+    int differences = 0;
+    for ( int i = 0; i < documents; ++i ) {
+        const std::wstring source = corpus.document();
+        if ( ! directory.empty() ) {
+            std::ostringstream path;
+            path << directory << "/case" << std::setw(4) << std::setfill('0') << i << ".md";
+            std::ofstream(path.str().c_str(), std::ios::binary) << markdown::utf8_encode(source);
+        }
+        const std::wstring expected = rescan.convert(source);
+        const std::wstring actual = single.convert(source);
+        if ( actual != expected ) {
+            ++differences;
+            std::cout << "case " << i << " differs\n--- source\n" << markdown::utf8_encode(source)
+                      << "--- rescan\n" << markdown::utf8_encode(expected)
+                      << "\n--- single pass\n" << markdown::utf8_encode(actual) << "\n" << std::endl;
+        }
+    }
+    std::cout << differences << " of " << documents << " documents differ" << std::endl;
+    return differences > 0 ? 1 : 0;
+}
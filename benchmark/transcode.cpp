@@ -0,0 +1,124 @@
+/*
+ * transcode.cpp
+ *
+ *  Created on: 2026/10/17
+ *      Author: mugwort_rc
+ *
+ * Throughput of the transcoders of Unicode.h.
+ *
+ * Each script gets a corpus built by repeating a sample text: plain
+ * ASCII, Latin with accented letters, CJK and emoji-heavy chat. The
+ * corpus is decoded from UTF-8, encoded back, and taken to UTF-16 and
+ * back, and the best run is reported in MB/s of UTF-8. The deprecated
+ * std::wstring_convert, which this module replaced, is measured on the
+ * same corpus for reference.
+ *
+ * usage: transcode [KiB per corpus=4096] [repeat=10]
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <codecvt>
+#include <cstdlib>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <locale>
+#include <string>
+#include <vector>
+
+#include "Unicode.h"
+
+struct Script
+{
+    const char*    name;
+    const wchar_t* sample;
+};
+
+const std::vector<Script>& scripts(void)
+{
+    static const std::vector<Script> result = {
+        {"ascii", L"The quick brown fox jumps over the lazy dog, and *emphasis* [links](http://example.com) "
+                  L"and `code spans` make up most of a README written in English.\n"},
+        {"latin", L"Le cœur déçu mais l'âme plutôt naïve, Louÿs rêva de crapaüter en canoë au delà des îles, "
+                  L"près du mälström où brûlent les novæ. Größe, Übung, façade.\n"},
+        {"cjk",   L"日本語の文章は漢字と平仮名と片仮名で書かれ、句読点も全角です。"
+                  L"中文文本主要由汉字组成。한국어 문장도 섞여 있습니다.\n"},
+        {"emoji", L"ok \U0001F600\U0001F44D great \U0001F389\U0001F389 see you \U0001F44B\U0001F3FD "
+                  L"\U0001F680 ship it \U0001F525\U0001F525\U0001F525 lol \U0001F602\n"},
+    };
+    return result;
+}
+
+/*!
+ * Best time in ms of `repeat` runs of `run`.
+ */
+double best_of(int repeat, const std::function<void(void)>& run)
+{
+    run();  //!< warm up
+    double best = std::numeric_limits<double>::max();
+    for ( int i = 0; i < repeat; ++i ) {
+        auto begin = std::chrono::steady_clock::now();
+        run();
+        auto end = std::chrono::steady_clock::now();
+        best = std::min(best, std::chrono::duration<double, std::milli>(end-begin).count());
+    }
+    return best;
+}
+
+int main(int argc, char* argv[])
+{
+    const std::size_t total = (argc > 1 ? std::atoi(argv[1]) : 4096) * 1024;
+    const int repeat = std::max(1, argc > 2 ? std::atoi(argv[2]) : 10);
+
+    std::cout << std::setw(8) << "script" << std::setw(12) << "bytes"
+              << std::setw(12) << "decode" << std::setw(12) << "encode"
+              << std::setw(12) << "to utf16" << std::setw(12) << "from utf16"
+              << std::setw(12) << "std decode" << std::setw(12) << "std encode"
+              << "  (MB/s of UTF-8)" << std::endl;
+    for ( const Script& script : scripts() ) {
+        const std::string sample = markdown::utf8_encode(script.sample);
+        std::string utf8;
+        while ( utf8.size() < total ) {
+            utf8 += sample;
+        }
+        const std::wstring wide = markdown::utf8_decode(utf8);
+        std::vector<char16_t> utf16(wide.size() * 2 + 1);
+        const std::size_t utf16_size = markdown::utf16_encode(wide.data(), wide.size(), utf16.data()) - utf16.data();
+
+        std::wstring decoded;
+        std::string encoded;
+        std::wstring_convert<std::codecvt_utf8<wchar_t> > reference;
+
+        const double decode = best_of(repeat, [&](){
+            decoded.clear();
+            markdown::utf8_decode(utf8, decoded);
+        });
+        const double encode = best_of(repeat, [&](){
+            encoded.clear();
+            markdown::utf8_encode(wide.data(), wide.size(), encoded);
+        });
+        const double to_utf16 = best_of(repeat, [&](){
+            markdown::utf16_encode(wide.data(), wide.size(), utf16.data());
+        });
+        const double from_utf16 = best_of(repeat, [&](){
+            decoded.clear();
+            markdown::utf16_decode(utf16.data(), utf16_size, decoded);
+        });
+        const double std_decode = best_of(repeat, [&](){
+            decoded = reference.from_bytes(utf8);
+        });
+        const double std_encode = best_of(repeat, [&](){
+            encoded = reference.to_bytes(wide);
+        });
+
+        auto mbps = [&](double ms){ return utf8.size() / (ms * 1000.0); };
+        std::cout << std::setw(8) << script.name << std::setw(12) << utf8.size()
+                  << std::fixed << std::setprecision(1)
+                  << std::setw(12) << mbps(decode) << std::setw(12) << mbps(encode)
+                  << std::setw(12) << mbps(to_utf16) << std::setw(12) << mbps(from_utf16)
+                  << std::setw(12) << mbps(std_decode) << std::setw(12) << mbps(std_encode) << std::endl;
+    }
+    return 0;
+}
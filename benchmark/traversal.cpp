@@ -0,0 +1,128 @@
+/*
+ * traversal.cpp
+ *
+ *  Created on: 2026/10/17
+ *      Author: mugwort_rc
+ *
+ * Cost of walking an ElementTree through the Element interface.
+ *
+ * Builds a document of nested sections and paragraphs and walks it with
+ * the sibling calls (getFirstElementChild / getNextElementSibling), with
+ * children() and with child(), reporting ns per visited element. The
+ * getElementsByTagName() lines report ns per returned element.
+ *
+ * usage: traversal [elements=100000] [repeat=20]
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <string>
+
+#include "ElementTree.h"
+#include "Initializer.h"
+
+/*!
+ * Sections of 10 paragraphs of 5 inline elements each, nested 4 deep.
+ */
+std::size_t build(markdown::Element parent, std::size_t budget, int depth)
+{
+    std::size_t created = 0;
+    while ( created < budget ) {
+        markdown::Element section(parent, depth < 3 ? L"div" : L"p");
+        parent.append(section);
+        section.setText(L"text");
+        ++created;
+        if ( depth < 3 ) {
+            created += build(section, std::min<std::size_t>(budget - created, 50), depth + 1);
+        } else {
+            for ( int i = 0; i < 5 && created < budget; ++i, ++created ) {
+                markdown::Element em(section, L"em");
+                section.append(em);
+                em.setText(L"emphasis");
+                em.setTail(L" tail");
+            }
+        }
+    }
+    return created;
+}
+
+std::size_t walk_siblings(const markdown::Element& elem)
+{
+    std::size_t count = 1;
+    for ( markdown::Element child = elem.getFirstElementChild(); ! child.isNull(); child = child.getNextElementSibling() ) {
+        count += walk_siblings(child);
+    }
+    return count;
+}
+
+std::size_t walk_children(const markdown::Element& elem)
+{
+    std::size_t count = 1;
+    for ( const markdown::Element child : elem.children() ) {
+        count += walk_children(child);
+    }
+    return count;
+}
+
+std::size_t walk_child(const markdown::Element& elem)
+{
+    std::size_t count = 1;
+    for ( const markdown::Element& child : elem.child() ) {
+        count += walk_child(child);
+    }
+    return count;
+}
+
+std::size_t by_tag_p(const markdown::Element& elem)
+{
+    return elem.getElementsByTagName(L"p").size();
+}
+
+std::size_t by_tag_any(const markdown::Element& elem)
+{
+    return elem.getElementsByTagName(L"*").size();
+}
+
+template<typename Walk>
+void measure(const char* name, Walk walk, const markdown::Element& root, int repeat)
+{
+    double best = std::numeric_limits<double>::max();
+    std::size_t visited = 0;
+    for ( int i = 0; i < repeat; ++i ) {
+        auto begin = std::chrono::steady_clock::now();
+        visited = walk(root);
+        auto end = std::chrono::steady_clock::now();
+        best = std::min(best, std::chrono::duration<double, std::nano>(end-begin).count());
+    }
+    std::cout << std::setw(12) << name << std::setw(10) << visited
+              << std::setw(12) << std::fixed << std::setprecision(1) << best / 1e6 << " ms"
+              << std::setw(10) << best / visited << " ns/element" << std::endl;
+}
+
+int main(int argc, char* argv[])
+{
+    Initializer init;
+
+    const std::size_t elements = argc > 1 ? std::atoi(argv[1]) : 100000;
+    const int repeat = std::max(1, argc > 2 ? std::atoi(argv[2]) : 20);
+
+    markdown::ElementTree doc(L"div");
+    markdown::Element root(doc);
+    auto begin = std::chrono::steady_clock::now();
+    build(root, elements, 0);
+    auto end = std::chrono::steady_clock::now();
+    std::cout << std::setw(12) << "build" << std::setw(10) << elements
+              << std::setw(12) << std::fixed << std::setprecision(1)
+              << std::chrono::duration<double, std::milli>(end-begin).count() << " ms" << std::endl;
+
+    measure("siblings", walk_siblings, root, repeat);
+    measure("children()", walk_children, root, repeat);
+    measure("child()", walk_child, root, repeat);
+    measure("tag p", by_tag_p, root, repeat);
+    measure("tag *", by_tag_any, root, repeat);
+    return 0;
+}
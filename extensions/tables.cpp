@@ -75,15 +75,12 @@ public:
             }
         }
         //! Build table
-        Element table(parent, L"table");
-        parent.append(table);
-        Element thead(table, L"thead");
-        table.append(thead);
-        this->build_row(header, thead, align, border);
-        Element tbody(table, L"tbody");
-        table.append(tbody);
+        ElementBuilder table(ElementBuilder(parent).append(L"table"));
+        ElementBuilder thead(table.append(L"thead"));
+        this->build_row(header, thead, L"th", align, border);
+        ElementBuilder tbody(table.append(L"tbody"));
         for ( const std::wstring& row : rows ) {
-            this->build_row(boost::algorithm::trim_copy(row), tbody, align, border);
+            this->build_row(boost::algorithm::trim_copy(row), tbody, L"td", align, border);
         }
     }
 
@@ -91,27 +88,16 @@ private:
     /*!
      * Given a row of text, build table cells.
      */
-    void build_row(const std::wstring& row, Element &parent, const std::list<boost::optional<std::wstring>>& align, bool border)
+    void build_row(const std::wstring& row, ElementBuilder &parent, const std::wstring& tag, const std::list<boost::optional<std::wstring>>& align, bool border)
     {
-        Element tr(parent, L"tr");
-        parent.append(tr);
-        std::wstring tag = L"td";
-        if ( parent.getTagName() == L"thead" ) {
-            tag = L"th";
-        }
+        ElementBuilder tr(parent.append(L"tr"));
         std::vector<std::wstring> cells = this->split_row(row, border);
         //! We use align here rather than cells to ensure every row
         //! contains the same number of columns.
+        const std::wstring empty;
         std::size_t i = 0;
-        for ( boost::optional<std::wstring> a : align ) {
-            Element c(tr, tag);
-            tr.append(c);
-            if ( cells.size() > i ) {
-                std::wstring cell = boost::algorithm::trim_copy(cells.at(i));
-                c.setText(cell);
-            } else {
-                c.setText(std::wstring());
-            }
+        for ( const boost::optional<std::wstring>& a : align ) {
+            Element c = tr.append(tag, cells.size() > i ? boost::algorithm::trim_copy(cells[i]) : empty);
             if ( a ) {
                 c.setAttribute(L"align", *a);
             }
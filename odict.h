@@ -165,6 +165,14 @@ public:
 
     }
 
+    /*!
+     * Return the keys in order.
+     */
+    std::vector<std::string> keys(void) const
+    {
+        return this->_keyOrder;
+    }
+
     Sequence toList(void) const
     {
         Sequence result;
@@ -1,24 +1,9 @@
 #include <iostream>
 #include <locale>
 
-#include <xercesc/util/PlatformUtils.hpp>
-
 #include "MarkdownCpp.h"
 #include "extensions/tables.h"
-
-class Initializer
-{
-public:
-    Initializer(void)
-    {
-        xercesc::XMLPlatformUtils::Initialize();
-    }
-    ~Initializer(void)
-    {
-        xercesc::XMLPlatformUtils::Terminate();
-    }
-
-};
+#include "benchmark/Initializer.h"
 
 void markdown_test(const std::wstring& name, const std::wstring& test)
 {
@@ -45,6 +30,7 @@ int main(int, char*[])
                                 L"**this is test too!**");
     //! Success !!
     markdown_test(L"link", L"This is [link](http://www.example.com).\n");
+    markdown_test(L"link title", L"This is [link](http://www.example.com \"Example\") and [another](/page 'Page 2').\n");
     markdown_test(L"reference", L"This is [referenced link][reference].\n"
                                 L"\n"
                                 L"\n[reference]: http://www.example.com \"Example\"");
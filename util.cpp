@@ -6,10 +6,40 @@
  */
 #include "util.h"
 
+#include <atomic>
+#include <map>
+#include <mutex>
+#include <utility>
+
+#include <boost/algorithm/string/predicate.hpp>
 #include <boost/format.hpp>
 
+#include "HtmlTag.h"
+
 namespace markdown{
 
+namespace {
+
+struct RegexCacheStore
+{
+    typedef std::pair<std::wstring, RegexCache::Flags> Key;
+
+    std::mutex mutex;
+    std::map<Key, boost::wregex> regexes;
+    std::atomic<std::size_t> hits;
+    std::atomic<std::size_t> misses;
+};
+
+//! Constructed on first use, so processors built during static
+//! initialization find it ready.
+RegexCacheStore& regex_cache_store(void)
+{
+    static RegexCacheStore store;
+    return store;
+}
+
+} // end of anonymous namespace
+
 boost::wregex util::BLOCK_LEVEL_ELEMENTS(L"^(p|div|h[1-6]|blockquote|pre|table|dl|ol|ul"
                                          L"|script|noscript|form|fieldset|iframe|math"
                                          L"|hr|hr/|style|li|dt|dd|thead|tbody"
@@ -21,12 +51,90 @@ const std::wstring util::STX = L"\u0002";
 const std::wstring util::ETX = L"\u0003";
 const std::wstring util::INLINE_PLACEHOLDER_PREFIX = util::STX+L"klzzwxh:";
 const std::wstring util::INLINE_PLACEHOLDER = util::INLINE_PLACEHOLDER_PREFIX + L"%s" + util::ETX;
-boost::wregex      util::INLINE_PLACEHOLDER_RE((boost::wformat(util::INLINE_PLACEHOLDER)%L"([0-9]{4})").str());
+boost::wregex      util::INLINE_PLACEHOLDER_RE((boost::wformat(util::INLINE_PLACEHOLDER)%L"([0-9]+)").str());
 const std::wstring util::AMP_SUBSTITUTE = util::STX+L"amp"+util::ETX;
 
+std::wstring util::inlinePlaceholder(std::size_t id)
+{
+    std::wstring result(INLINE_PLACEHOLDER_PREFIX);
+    result += std::to_wstring(id);
+    result += ETX;
+    return result;
+}
+
+bool util::parseInlinePlaceholder(const std::wstring& text, std::size_t pos, std::size_t& id, std::size_t& end)
+{
+    if ( text.compare(pos, INLINE_PLACEHOLDER_PREFIX.size(), INLINE_PLACEHOLDER_PREFIX) != 0 ) {
+        return false;
+    }
+    std::size_t i = pos + INLINE_PLACEHOLDER_PREFIX.size();
+    const std::size_t digits = i;
+    std::size_t value = 0;
+    for ( ; i < text.size() && L'0' <= text[i] && text[i] <= L'9'; ++i ) {
+        const std::size_t digit = text[i] - L'0';
+        if ( value > (static_cast<std::size_t>(-1) - digit) / 10 ) {
+            return false;  //!< no stash is that large
+        }
+        value = value*10 + digit;
+    }
+    if ( i == digits || i >= text.size() || text[i] != ETX[0] ) {
+        return false;
+    }
+    id = value;
+    end = i + 1;
+    return true;
+}
+
 bool util::isBlockLevel(const std::wstring& tag)
 {
-	return boost::regex_match(tag, util::BLOCK_LEVEL_ELEMENTS);
+	//! "hr/" is the only name of BLOCK_LEVEL_ELEMENTS that is not a tag
+	return ( HtmlTag::properties(tag) & HtmlTag::block_level ) != 0 || boost::algorithm::iequals(tag, L"hr/");
+}
+
+boost::wregex RegexCache::get(const std::wstring& pattern, Flags flags)
+{
+    RegexCacheStore& store = regex_cache_store();
+    RegexCacheStore::Key key(pattern, flags);
+    {
+        std::lock_guard<std::mutex> lock(store.mutex);
+        auto it = store.regexes.find(key);
+        if ( it != store.regexes.end() ) {
+            ++store.hits;
+            return it->second;
+        }
+    }
+    //! Compile outside the lock; if another thread won the race, its
+    //! expression is kept and this one is dropped.
+    boost::wregex compiled(pattern, flags);
+    ++store.misses;
+    std::lock_guard<std::mutex> lock(store.mutex);
+    return store.regexes.insert(std::make_pair(key, compiled)).first->second;
+}
+
+std::size_t RegexCache::hits(void)
+{
+    return regex_cache_store().hits;
+}
+
+std::size_t RegexCache::misses(void)
+{
+    return regex_cache_store().misses;
+}
+
+std::size_t RegexCache::size(void)
+{
+    RegexCacheStore& store = regex_cache_store();
+    std::lock_guard<std::mutex> lock(store.mutex);
+    return store.regexes.size();
+}
+
+void RegexCache::clear(void)
+{
+    RegexCacheStore& store = regex_cache_store();
+    std::lock_guard<std::mutex> lock(store.mutex);
+    store.regexes.clear();
+    store.hits = 0;
+    store.misses = 0;
 }
 
 HtmlStash::HtmlStash() :
@@ -47,7 +155,7 @@ void HtmlStash::reset(void)
     this->rawHtmlBlocks = Items();
 }
 
-std::wstring HtmlStash::get_placeholder(int key)
+std::wstring HtmlStash::get_placeholder(int key) const
 {
 	return (boost::wformat(L"%swzxhzdk:%d%s") % util::STX % key % util::ETX).str();
 }
@@ -8,6 +8,7 @@
 #ifndef UTIL_H_
 #define UTIL_H_
 
+#include <cstddef>
 #include <string>
 #include <boost/regex.hpp>
 
@@ -27,6 +28,22 @@ static const std::wstring INLINE_PLACEHOLDER;
 static boost::wregex      INLINE_PLACEHOLDER_RE;
 static const std::wstring AMP_SUBSTITUTE;
 
+/*!
+ * The inline placeholder of stash entry `id`: INLINE_PLACEHOLDER_PREFIX,
+ * the id in decimal without padding, and ETX.
+ */
+static std::wstring inlinePlaceholder(std::size_t id);
+
+/*!
+ * Parse the inline placeholder at `pos` of `text`.
+ *
+ * Returns false if there is none; otherwise stores its id and the
+ * position following it.
+ */
+static bool parseInlinePlaceholder(const std::wstring& text, std::size_t pos, std::size_t& id, std::size_t& end);
+
+//! Same names as BLOCK_LEVEL_ELEMENTS, looked up in the HtmlTag table.
+//! Elements should use HtmlTag::isBlockLevel(elem.getTag()) instead.
 static bool isBlockLevel(const std::wstring& tag);
 
 private:
@@ -37,6 +54,45 @@ private:
 
 };
 
+/*!
+ * Process-wide cache of compiled regular expressions.
+ *
+ * Processors compile their expressions when a Markdown instance is
+ * built. The cache keys them by pattern text and flags, so building
+ * further instances only copies handles to the compiled expressions
+ * (boost::basic_regex shares its state between copies, and a compiled
+ * expression is safe to use from several threads).
+ *
+ * get() is thread-safe. The hit/miss counters tell how often an
+ * expression was found in the cache or had to be compiled.
+ */
+class RegexCache
+{
+public:
+    typedef boost::regex_constants::syntax_option_type Flags;
+
+public:
+    static boost::wregex get(const std::wstring& pattern, Flags flags=boost::regex_constants::normal);
+
+    static std::size_t hits(void);
+    static std::size_t misses(void);
+    static std::size_t size(void);
+
+    /*!
+     * Drop every cached expression and reset the counters.
+     *
+     * Instances already built keep their own handles.
+     */
+    static void clear(void);
+
+private:
+	RegexCache(void);
+	RegexCache(const RegexCache&);
+	~RegexCache(void);
+	RegexCache& operator=(const RegexCache&);
+
+};
+
 class HtmlStash
 {
 public:
@@ -49,7 +105,7 @@ public:
     std::wstring store(const std::wstring& html, bool safe=false);
 	void reset(void);
 
-    std::wstring get_placeholder(int key);
+    std::wstring get_placeholder(int key) const;
 
 public:
     int   html_counter;